@@ -5,6 +5,7 @@ import json
 import time
 import random
 import re
+import struct
 import requests
 from requests.exceptions import ChunkedEncodingError
 import ormsgpack
@@ -16,24 +17,52 @@ def query_dreams(host, port, params):
     r.raise_for_status()
     return ormsgpack.unpackb(r.content)
 
-def download_dream(host, port, download_url):
-    url = f"http://{host}:{port}/dream_download"
-    # POST body = full URL
-    # should already be utf-8 encoded but just making sure...
-    r = requests.post(url, data=download_url.encode('utf-8'))
-    r.raise_for_status()
+def expected_size(r, offset):
+    # total size of the blob, None if the server didn't say
+    content_range = r.headers.get("Content-Range", "")
+    if r.status_code == 206 and "/" in content_range:
+        total = content_range.rsplit("/", 1)[1]
+        return int(total) if total.isdigit() else None
+    length = r.headers.get("Content-Length")
+    return offset + int(length) if length and length.isdigit() else None
 
-    try:
-        data = bytearray()
-        for chunk in r.iter_content(chunk_size=8192):
-            if chunk:  # filter out keep-alive chunks
-                data.extend(chunk)
-
-    except (ChunkedEncodingError) as e:
-        # server closed early: treat what we got as 'the full body'
-        print(f"[!] Warning: incomplete read ({e})")
+def download_dream(host, port, download_url, max_attempts=5):
+    url = f"http://{host}:{port}/dream_download"
+    data = bytearray()
+    total = None
+
+    for attempt in range(max_attempts):
+        headers = {}
+        if data:
+            # only ask for the bytes that are still missing
+            headers["Range"] = f"bytes={len(data)}-"
+
+        # POST body = full URL
+        # should already be utf-8 encoded but just making sure...
+        r = requests.post(url, data=download_url.encode('utf-8'), headers=headers, stream=True)
+        if r.status_code == 416 and data:
+            # nothing left to fetch
+            break
+        r.raise_for_status()
+        if r.status_code != 206:
+            # the server sent everything again
+            data = bytearray()
+        total = expected_size(r, len(data))
+
+        try:
+            for chunk in r.iter_content(chunk_size=8192):
+                if chunk:  # filter out keep-alive chunks
+                    data.extend(chunk)
+        except (ChunkedEncodingError, requests.exceptions.ConnectionError) as e:
+            print(f"[!] Warning: incomplete read ({e}), resuming at {len(data)} bytes")
+            continue
 
+        if total is None or len(data) >= total:
+            return bytes(data)
 
+    if total is not None and len(data) < total:
+        # out of attempts: treat what we got as 'the full body'
+        print(f"[!] Warning: incomplete download, got {len(data)} of {total} bytes")
     return bytes(data)
 
 def download_dream_from_msgpack(host, port, dream):
@@ -75,7 +104,9 @@ def save_dream(dream, host, port):
     # Download dream + meta
     logging.info(f"Downloading dream {da_text}...")
     body, meta = download_dream_from_msgpack(host, port, dream)
+    write_dream(da_text, body, meta)
 
+def write_dream(da_text, body, meta):
     # Timestamp formatting
     tt = meta.get("mMtCurUploadTime")
     date_time = f'{tt.get("mYear",0):04d}.{tt.get("mMonth",0):02d}.{tt.get("mDay",0):02d}@{tt.get("mHour",0):02d}-{tt.get("mMin",0):02d}'
@@ -92,6 +123,58 @@ def save_dream(dream, host, port):
     with open(os.path.join(base_dir, "dream_land_meta.json"), "w", encoding="utf-8") as f:
         json.dump(meta, f, ensure_ascii=False, indent=2)
 
+BUNDLE_MAGIC = b"DRMBNDL1"
+FRAME_DATA, FRAME_END, FRAME_FAILED = 0, 1, 2
+ARCHIVE_END = 0xFFFFFFFF
+
+def download_bundle(host, port, ids):
+    # One request for query, meta and body of every dream, see DreamBundle.hpp for the layout
+    url = f"http://{host}:{port}/dream_bundle"
+    r = requests.post(url, data="\n".join(ids).encode('utf-8'))
+    r.raise_for_status()
+    data = r.content
+
+    if data[:8] != BUNDLE_MAGIC:
+        raise ValueError("not a dream bundle")
+    index_size = struct.unpack_from("<I", data, 8)[0]
+    index = ormsgpack.unpackb(data[12:12 + index_size])
+    pos = 12 + index_size
+
+    parts = [bytearray() for _ in index]
+    ok = [False] * len(index)
+    while True:
+        entry, flags, length = struct.unpack_from("<III", data, pos)
+        pos += 12
+        if entry == ARCHIVE_END:
+            break
+        if flags == FRAME_DATA:
+            parts[entry].extend(data[pos:pos + length])
+            pos += length
+        else:
+            ok[entry] = flags == FRAME_END
+
+    # dream id -> {"query": ..., "meta": ..., "body": ...}, failed entries are left out
+    dreams = {}
+    for i, info in enumerate(index):
+        if ok[i]:
+            dreams.setdefault(info["id"], {})[info["kind"]] = bytes(parts[i])
+    return dreams
+
+def cmd_bundle(args):
+    with open(args.file, "r") as i_file:
+        ids = [re.sub("[DA\-]", "", line.strip()) for line in i_file]
+    ids = [i for i in ids if i]
+
+    dreams = download_bundle(args.host, args.port, ids)
+    for dream_id in ids:
+        parts = dreams.get(str(int(dream_id)), {})
+        if "meta" not in parts or "body" not in parts:
+            logging.error(f"Dream {format_da_id(int(dream_id))} not found or incomplete.")
+            continue
+        da_text = format_da_id(int(dream_id))
+        logging.info(f"Saving dream {da_text}...")
+        write_dream(da_text, parts["body"], ormsgpack.unpackb(parts["meta"]))
+
 def cmd_id(args):
     result = query_dreams(args.host, args.port,
                           {"id" : args.id})
@@ -173,6 +256,10 @@ def main():
     p_id.add_argument("file", help="file with addresses")
     p_id.set_defaults(func=cmd_id_batch)
 
+    p_bundle = sub.add_parser("bundle", help="Download a Dream ID batch in a single request")
+    p_bundle.add_argument("file", help="file with addresses")
+    p_bundle.set_defaults(func=cmd_bundle)
+
     p_ln = sub.add_parser("land_name", help="Download by Island Name")
     p_ln.add_argument("land_name", help="Name of the island")
     p_ln.set_defaults(func=cmd_land_name)
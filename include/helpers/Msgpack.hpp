@@ -0,0 +1,54 @@
+#pragma once
+
+#include <switch/types.h>
+
+#include <cstddef>
+#include <string>
+
+// Minimal MessagePack support for the API responses.
+// The reader walks a buffer in place without building a tree, values that aren't
+// needed are skipped. The writer appends to a string.
+
+class MsgpackReader {
+public:
+    MsgpackReader(const char* data, size_t size);
+
+    bool readArrayHeader(u32& count);
+    bool readMapHeader(u32& count);
+    bool readString(std::string& out);
+    bool readInt(s64& out);
+    // Skips one complete value, including everything nested in it
+    bool skip();
+
+    // Expects a map at the current position and moves to the value of key.
+    // On false the position is undefined.
+    bool findKey(const std::string& key);
+
+    size_t offset() const { return m_offset; }
+    bool atEnd() const { return m_offset >= m_size; }
+
+private:
+    bool readLength(size_t bytes, u64& out);
+    bool advance(u64 bytes);
+
+    const u8* m_data;
+    size_t m_size;
+    size_t m_offset;
+};
+
+class MsgpackWriter {
+public:
+    explicit MsgpackWriter(std::string& out) : m_out(out) {}
+
+    void writeArrayHeader(u32 count);
+    void writeMapHeader(u32 count);
+    void writeString(const std::string& value);
+    void writeInt(s64 value);
+    // Appends an already encoded value
+    void writeRaw(const char* data, size_t size);
+
+private:
+    void writeBigEndian(u64 value, size_t bytes);
+
+    std::string& m_out;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <switch/types.h>
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// Bounded lock-free queue for status lines, the network thread pushes and the UI thread pops.
+// Based on Dmitry Vyukov's bounded MPMC queue, so several producers are fine as well.
+// Messages are dropped instead of blocking when the UI falls behind.
+
+class StatusQueue {
+public:
+    static constexpr size_t Capacity = 64; // must be a power of two
+    static constexpr size_t MessageSize = 160;
+
+    struct Message {
+        char text[MessageSize];
+    };
+
+    StatusQueue();
+
+    bool push(const char* text);
+    bool pushf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    bool pop(Message& out);
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Message message;
+    };
+
+    Cell* acquireCell();
+    void publishCell(Cell* cell);
+
+    std::array<Cell, Capacity> m_cells;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+};
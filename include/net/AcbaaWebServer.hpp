@@ -1,60 +1,96 @@
 #pragma once
 
 #include "IWebServer.hpp"
-#include "HttpClient.hpp"
 #include "HttpRequest.hpp"
+#include "AcbaaWorker.hpp"
+#include "ServerThread.hpp"
+#include "WakeupSocket.hpp"
+#include "ResponseCache.hpp"
+#include "BlobStore.hpp"
 
+#include <helpers/StatusQueue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
 #include <unordered_map>
 #include <string>
-#include <functional>
+#include <string_view>
 #include <optional>
 
-class AcbaaWebServer : public HttpClient, public IWebServer {
+// Accepts LAN clients and hands them to a pool of AcbaaWorkers,
+// which build the upstream requests through the route table in AcbaaWebServer.cpp.
+
+class AcbaaWebServer : public IWebServer {
 public:
+    enum class RouteResult {
+        Ok,
+        NotFound,
+        BadRequest
+    };
+
     AcbaaWebServer(const std::string& bearerToken);
     ~AcbaaWebServer();
 
     bool start(u16 port) override;
-    bool serverLoop() override;
+    bool serverLoop(int timeoutMs) override;
+    void stop() override;
+    bool isRunning() const override;
+
+    // Status lines go here instead of stdout, so another thread can print them
+    void setStatusQueue(StatusQueue* queue);
+    // Thread-safe as long as the status queue is set
+    void reportStatus(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+    // Thread-safe, the route table is constant
+    RouteResult buildRequest(std::string_view route, const std::string& body, const std::unordered_map<std::string, std::string>& queryParams, HttpRequest& request) const;
+
+    // 0 = responses of this route are not cached
+    std::chrono::seconds getCacheTtl(std::string_view route) const;
+    ResponseCache& getResponseCache();
+
+    // Set before start(), the store has to be open already
+    void setBlobStore(std::unique_ptr<BlobStore> store);
+    BlobStore* getBlobStore();
+    bool usesBlobStore(std::string_view route) const;
+    // Range/If-Range of the client are forwarded upstream
+    bool acceptsRanges(std::string_view route) const;
+    // Upstream is paged with offset/limit, clients may ask for several pages at once
+    bool supportsPaging(std::string_view route) const;
+
+    // Plain text counters for /stats
+    std::string buildStatsReport() const;
 
 protected:
+    // Hands an accepted connection to a worker
     void handleClient(int fd) override;
 private:
     int m_serverFd;
-    bool m_running;
+    std::atomic<bool> m_running;
+    WakeupSocket m_wakeup;
+
+    StatusQueue* m_statusQueue;
+
+    std::vector<std::unique_ptr<AcbaaWorker>> m_workers;
+    std::vector<std::unique_ptr<ServerThread>> m_workerThreads;
+    size_t m_nextWorker;
 
     std::string m_bearerToken;
     std::string m_userAgent;
     std::string m_baseUrl;
+    // User-Agent and Accept, plus the bearer token for routes that need it
+    std::shared_ptr<const HttpRequest::BaseHeaders> m_baseHeaders;
+    std::shared_ptr<const HttpRequest::BaseHeaders> m_authorizedBaseHeaders;
+
+
+    ResponseCache m_responseCache;
+    std::unique_ptr<BlobStore> m_blobStore;
+
+    bool startWorkers();
+    void acceptClients();
     
-    // Route -> (ParamKey -> RequestBuilder)
-    std::unordered_map<
-        std::string,
-        std::unordered_map<
-            std::string,
-            std::function<std::optional<HttpRequest>(const std::string&, const std::unordered_map<std::string, std::string>&)>
-        >
-    > m_routeRequestBuilders;
-
-    std::unordered_map<std::string, bool> m_routeAuthorizationExemptions;
-    
-    std::tuple<
-    std::string,                                        // method
-    std::string,                                        // uri
-    std::string,                                        // postBody
-    std::unordered_map<std::string, std::string>       // queryParams
-    > parseHttpRequest(const std::string& fullReq);
-    
-    size_t parseContentLength(const std::string& headers);
-    
-    void handleRequest(const std::string& route, int clientFd, const std::string& body, const std::unordered_map<std::string, std::string>& queryParams);
-    
-    void initRouteRequestBuilders();
-    
-    // Common request setup
-    void prepareRequest(HttpRequest& request, const std::string& route);
-    
-    void sendBadRequest(int clientFd);
-    void sendNotFound(int clientFd);
+    // Common request setup, authorize adds the bearer token
+    void prepareRequest(HttpRequest& request, bool authorize) const;
     
 };
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "IEventLoop.hpp"
+#include "HttpClient.hpp"
+#include "HttpRequest.hpp"
+#include "HttpRequestParser.hpp"
+#include "WakeupSocket.hpp"
+#include "WorkStealingQueue.hpp"
+#include "BlobStore.hpp"
+#include "DreamBundle.hpp"
+#include "PagedQuery.hpp"
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <string>
+
+class AcbaaWebServer;
+
+// Serves the connections the acceptor assigned to it (or that it stole from a peer)
+// on its own thread, with its own curl multi handle.
+
+class AcbaaWorker : public HttpClient, public IEventLoop {
+public:
+    AcbaaWorker(AcbaaWebServer& server, std::shared_ptr<SharedCurlCache> cache);
+    ~AcbaaWorker();
+
+    bool open();
+    void setPeers(const std::vector<AcbaaWorker*>& peers);
+
+    bool serverLoop(int timeoutMs) override;
+    void stop() override;
+    bool isRunning() const override;
+
+    // Called from the acceptor thread
+    void assignConnection(int clientFd);
+    size_t getLoad() const;
+
+protected:
+    void onStreamingRequestDone(int outputFd, bool success, std::string unsent) override;
+private:
+    // Per-connection state machine, driven by serverLoop()
+    struct Connection {
+        enum class State {
+            ReadingRequest, // waiting for the full request head + body
+            Relaying,       // upstream transfer is streaming into the socket
+            Writing,        // a locally built response (cache hit, stored blob, /stats) is being sent
+        };
+
+        int fd;
+        State state;
+        std::string buffer;   // received bytes, may already hold the next pipelined requests
+        HttpRequestParser parser; // of the request at the front of buffer
+        bool keepAlive;       // of the request currently being answered
+        bool peerClosed;      // client shut down its sending side
+        std::string output;   // pending local response
+        size_t outputOffset;
+        int fileFd;           // blob the rest of the local response is read from
+        u64 fileRemaining;
+        std::unique_ptr<DreamBundle> bundle; // still appending to output while it runs
+        std::unique_ptr<PagedQuery> pagedQuery;
+        std::chrono::steady_clock::time_point lastActivity;
+
+        Connection(int clientFd)
+            : fd(clientFd), state(State::ReadingRequest), keepAlive(false), peerClosed(false),
+              outputOffset(0), fileFd(-1), fileRemaining(0), lastActivity(std::chrono::steady_clock::now()) {}
+    };
+
+    // Request headers that change how a request is answered
+    struct RequestHints {
+        bool bypassCache = false;
+        std::string range;    // empty without a Range header
+        std::string ifRange;
+    };
+
+    AcbaaWebServer& m_server;
+    WakeupSocket m_wakeup;
+    std::atomic<bool> m_running;
+
+    WorkStealingQueue<int> m_pending;
+    std::atomic<size_t> m_load; // pending + open connections
+    std::vector<AcbaaWorker*> m_peers;
+
+    std::unordered_map<int, Connection> m_connections;
+
+    void adoptConnections();
+    // Closes connections idle for too long, returns ms until the next one expires (-1 = none)
+    int expireIdleConnections();
+    void handleClient(int clientFd);
+    // Answers the complete requests in the connection buffer, in order, until one is relaying
+    void processRequests(int clientFd);
+    // Returns true if a relay or a queued response now owns the connection
+    bool handleRequest(Connection& conn, const std::string& route, const std::string& body, const std::unordered_map<std::string, std::string>& queryParams, const RequestHints& hints);
+    // Answers from a stored blob, honoring Range/If-Range. False if the blob is gone.
+    bool serveBlob(Connection& conn, const BlobStore::Blob& blob, const RequestHints& hints);
+    // Back to reading the next request, or closed, once a response is complete
+    void finishResponse(int clientFd, bool success);
+    void queueResponse(Connection& conn, std::string response);
+    // Sends head, then size bytes of fileFd, the connection takes over the file
+    void queueFileResponse(Connection& conn, std::string head, int fileFd, u64 size);
+    void closeFile(Connection& conn);
+    // Streams a /dream_bundle archive as a chunked response
+    bool startBundle(Connection& conn, const std::string& body, const std::unordered_map<std::string, std::string>& queryParams);
+    void appendChunk(int clientFd, const char* data, size_t size);
+    // Fetches the pages asked for with pages=/max_results= and answers with the merged result
+    bool startPagedQuery(Connection& conn, const std::string& route, const HttpRequest& request, size_t pages, size_t maxResults, const RequestHints& hints);
+    // Returns false if the connection broke
+    bool flushOutput(Connection& conn);
+    void handleWritable(int clientFd);
+    void closeConnection(int clientFd);
+    
+    void sendBadRequest(int clientFd);
+    // 431 for a request head over the limit, 413 for a body
+    void sendTooLarge(int clientFd, bool head);
+    void sendNotFound(int clientFd);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "HttpClient.hpp"
+
+#include <switch/types.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Persistent cache of downloaded blobs on the SD card.
+// Files are named by the SHA-256 of their content, so identical blobs behind different
+// URLs are stored once. An index maps upstream URL paths to blobs and keeps the LRU order
+// across restarts. Shared by all workers.
+
+class BlobStore {
+public:
+    // Hits are sent to the client in blocks of this size
+    static constexpr size_t ReadBlockSize = 128 * 1024;
+
+    struct Blob {
+        std::string path;
+        std::string hash;
+        std::string contentType;
+        u64 size;
+    };
+
+    struct Stats {
+        u64 hits = 0;
+        u64 misses = 0;
+        u64 stores = 0;
+        u64 evictions = 0;
+        size_t entries = 0;  // URL paths
+        u64 bytes = 0;       // unique blobs on the card
+    };
+
+    BlobStore(std::string directory, u64 maxBytes);
+
+    // Creates the directory, loads the index and removes files it doesn't reference
+    bool open();
+
+    // Upstream URL -> key, only the path counts since query strings carry expiring signatures
+    static std::string makeKey(const std::string& url);
+
+    std::optional<Blob> find(const std::string& key);
+
+    // Writes a relayed response to the card and adds it once it completed with 200
+    std::unique_ptr<HttpClient::Sink> createFillSink(const std::string& key);
+
+    Stats getStats() const;
+
+private:
+    class FillSink;
+
+    struct Entry {
+        std::string hash;
+        std::string contentType;
+    };
+
+    struct File {
+        u64 size;
+        u32 refs;
+    };
+
+    typedef std::list<std::pair<std::string, Entry>> LruList;
+
+    void add(const std::string& key, const std::string& tempPath, const std::string& hash, u64 size, const std::string& contentType);
+    void evict(LruList::iterator it);
+    void saveIndex();
+    std::string blobPath(const std::string& hash) const;
+    std::string indexPath() const;
+    std::string nextTempPath();
+
+    std::string m_directory;
+    u64 m_maxBytes;
+    std::atomic<u32> m_nextTemp;
+
+    mutable std::mutex m_mutex;
+    LruList m_lru; // most recently used first
+    std::unordered_map<std::string, LruList::iterator> m_index;
+    std::unordered_map<std::string, File> m_files; // hash -> blob on the card
+    Stats m_stats;
+};
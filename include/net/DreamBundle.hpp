@@ -0,0 +1,88 @@
+#pragma once
+
+#include "HttpClient.hpp"
+
+#include <switch/types.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class AcbaaWebServer;
+
+// Fetches query result, meta and body of several dreams on the Switch and writes them
+// as one archive, so a client needs a single round trip instead of three per dream.
+//
+// Layout, all integers little endian:
+//   "DRMBNDL1"
+//   u32 index size, index: msgpack array of {"id": dream id, "kind": "query"|"meta"|"body"}
+//   frames: u32 entry, u32 flags, u32 length, payload
+// Frames of different entries interleave. Every entry ends with a FrameEnd or FrameFailed
+// frame, the archive with a FrameEnd frame for ArchiveEnd.
+
+class DreamBundle {
+public:
+    static constexpr u32 FrameData = 0;
+    static constexpr u32 FrameEnd = 1;
+    static constexpr u32 FrameFailed = 2;
+    static constexpr u32 ArchiveEnd = 0xFFFFFFFF;
+
+    static constexpr size_t MaxDreams = 32;
+    // Upstream downloads running at the same time
+    static constexpr size_t MaxParallelFetches = 2;
+
+    typedef std::function<void(const char* data, size_t size)> WriteFunc;
+    typedef std::function<void()> DoneFunc;
+
+    // done is called after the last write, not from the destructor
+    DreamBundle(AcbaaWebServer& server, HttpClient& client, std::vector<std::string> dreamIds, WriteFunc write, DoneFunc done);
+    // Cancels the transfers that are still running
+    ~DreamBundle();
+
+    // Accepts "DA-1234-5678-9012" or plain digits, separated by whitespace or commas
+    static std::vector<std::string> parseDreamIds(const std::string& text);
+
+    void start();
+    bool isDone() const { return m_done; }
+
+private:
+    class QuerySink;
+    class EntrySink;
+
+    struct Dream {
+        std::string id;
+        std::string query;  // raw msgpack of the query result
+        bool queryOk = false;
+        std::string metaUrl;
+        std::string bodyUrl;
+    };
+
+    struct Entry {
+        size_t dream;
+        std::string kind;
+        std::string url;
+    };
+
+    void onQueryDone(size_t dream, bool success, std::string body);
+    void writeIndex();
+    void startFetches();
+    // Returns false if the entry completed right away
+    bool startFetch(u32 entry);
+    void onFetchDone(u32 entry, bool success);
+    void writeFrame(u32 entry, u32 flags, const char* data, size_t size);
+    void finish();
+
+    AcbaaWebServer& m_server;
+    HttpClient& m_client;
+    WriteFunc m_write;
+    DoneFunc m_doneCallback;
+
+    std::vector<Dream> m_dreams;
+    std::vector<Entry> m_entries;
+    std::vector<HttpClient::TransferHandle> m_transfers;
+    size_t m_pendingQueries;
+    u32 m_nextFetch;
+    size_t m_runningFetches;
+    bool m_closing;
+    bool m_done;
+};
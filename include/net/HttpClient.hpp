@@ -1,27 +1,135 @@
 #pragma once
 
 #include "HttpRequest.hpp"
+#include "SharedCurlCache.hpp"
 
 #include <curl/curl.h>
+#include <poll.h>
 
 #include <string>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <unordered_map>
 
 class HttpClient {
 public:
-    HttpClient();
+    // Receives the response of an asynchronous transfer.
+    // Returning false from onHeader/onData aborts the transfer.
+    class Sink {
+    public:
+        virtual ~Sink() = default;
+        // One raw header line per call, including the status line and the terminating CRLF line
+        virtual bool onHeader(const char* data, size_t size) { return true; }
+        virtual bool onData(const char* data, size_t size) = 0;
+        virtual void onComplete(bool success, long responseCode) {}
+    protected:
+        // Called from onData instead of taking the data: the transfer pauses and
+        // onData gets the same data again once fd is writable
+        void pauseUntilWritable(int fd) { m_pauseFd = fd; }
+    private:
+        friend class HttpClient;
+        int m_pauseFd = -1;
+    };
+
+    // Sink that keeps the status code and Content-Type of the final response head
+    class ResponseHeadSink : public Sink {
+    public:
+        bool onHeader(const char* data, size_t size) override;
+    protected:
+        int m_status = 0;
+        std::string m_contentType = "application/octet-stream";
+    };
+
+    typedef u64 TransferHandle;
+    static constexpr TransferHandle InvalidTransfer = 0;
+
+    struct Stats {
+        u64 setupCount = 0;     // easy handles prepared for a request
+        u64 setupTimeUs = 0;    // time spent preparing them, divide by setupCount for the per-request cost
+        u64 handlesReused = 0;  // taken from the pool instead of curl_easy_init
+        u64 relaySends = 0;     // sendmsg calls of streaming relays, blocked ones included
+        u64 relayFrames = 0;    // body frames they sent, one chunk each in chunked mode
+        u64 relayBytes = 0;     // bytes they sent, head and framing included
+    };
+
+    // Clients on different threads may pass the same cache, without one a private one is created
+    HttpClient(std::shared_ptr<SharedCurlCache> cache = nullptr);
     virtual ~HttpClient();
 
     HttpRequest createRequest(const std::string& url);
 
+    // Blocking wrappers around submit() + pump()
     virtual bool sendRequest(const HttpRequest& request, HttpRequest::Reply& reply, bool debug = false);
     virtual bool sendStreamingRequest(const HttpRequest& request, int outputFd, bool debug = false);
 
+    // Queues a request on the multi handle and returns immediately.
+    // The sink is owned by the transfer until Sink::onComplete was called.
+    TransferHandle submit(const HttpRequest& request, std::unique_ptr<Sink> sink);
+    // Aborts a running transfer, its sink gets onComplete(false, ...)
+    void cancel(TransferHandle handle);
+    bool isRunning(TransferHandle handle) const;
+
+    // Relays the response of request to outputFd as an HTTP response,
+    // onStreamingRequestDone() is called once it finished.
+    // outputFd may be non-blocking, the transfer pauses while it is full.
+    // keepAlive only decides what the response advertises, the caller owns the connection.
+    // tee gets a copy of the upstream response as it is relayed.
+    bool startStreamingRequest(const HttpRequest& request, int outputFd, bool keepAlive = false, std::unique_ptr<Sink> tee = nullptr);
+
+    // Polls the curl sockets for up to timeoutMs (-1 = until curl needs attention)
+    // and advances all transfers. Returns the number of running transfers.
+    size_t pump(int timeoutMs);
+
+    Stats getStats() const;
+
+    // Building blocks of pump() for callers that own a poll set:
+    // append the curl sockets, poll with pollTimeout(), then hand the appended range back.
+    void collectPollFds(std::vector<pollfd>& fds) const;
+    int pollTimeout(int maxTimeoutMs) const;
+    void processPollFds(const pollfd* fds, size_t count);
+
 protected:
+    // unsent is the end of the response that didn't fit into outputFd anymore, the caller sends it
+    virtual void onStreamingRequestDone(int outputFd, bool success, std::string unsent) {}
+
     static size_t writeCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
     static size_t writeHeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
     static size_t writeCallbackStream(char* ptr, size_t size, size_t nmemb, void* userdata);
     static size_t writeHeaderCallbackStream(char* ptr, size_t size, size_t nmemb, void* userdata);
     static int debugCallback(CURL* handle, curl_infotype type, char* data, size_t size, void* userptr);
 private:
-    CURLSH* m_shared;
+    struct Transfer;
+    class ReplySink;
+    class StreamSink;
+
+    // Idle easy handles are kept with their base options applied, up to this many
+    static constexpr size_t maxIdleHandles = 8;
+
+    CURL* createEasyHandle(const HttpRequest& request, const std::string& fullUrl, struct curl_slist* headerList);
+    CURL* acquireEasyHandle();
+    void releaseEasyHandle(CURL* curl);
+    void applyBaseOptions(CURL* curl);
+    // Per-request headers in front of the shared base list, free with freeHeaderList()
+    static struct curl_slist* buildHeaderList(const HttpRequest& request);
+    static void freeHeaderList(struct curl_slist* headerList, const HttpRequest::BaseHeaders* base);
+    void completeTransfers();
+    bool runUntilDone(TransferHandle handle);
+
+    static size_t sinkWriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
+    static size_t sinkHeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
+    static int socketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp);
+    static int timerCallback(CURLM* multi, long timeoutMs, void* userp);
+
+    std::shared_ptr<SharedCurlCache> m_cache;
+    CURLM* m_multi;
+    TransferHandle m_nextHandle;
+    std::unordered_map<CURL*, std::unique_ptr<Transfer>> m_transfers;
+    std::unordered_map<TransferHandle, CURL*> m_handles;
+    // curl socket -> POLLIN/POLLOUT interest, maintained by socketCallback
+    std::unordered_map<curl_socket_t, short> m_sockets;
+    std::optional<std::chrono::steady_clock::time_point> m_timerDeadline;
+    std::vector<CURL*> m_idleHandles;
+    Stats m_stats;
 };
@@ -2,11 +2,16 @@
 
 #include <switch/types.h>
 
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <utility>
 #include <cstdint>
 
+struct curl_slist;
+
 class HttpRequest {
 public:
     enum class MimeType {
@@ -31,30 +36,60 @@ public:
 		int responseCode;
 	};
 
+    // Headers that are the same for many requests (User-Agent, Authorization, ...).
+    // They are turned into a curl list once, which all requests using them share;
+    // per-request headers are put in front of it.
+    class BaseHeaders {
+    public:
+        explicit BaseHeaders(HeaderFields fields);
+        ~BaseHeaders();
+        BaseHeaders(const BaseHeaders&) = delete;
+        BaseHeaders& operator=(const BaseHeaders&) = delete;
+
+        const HeaderFields& fields() const { return m_fields; }
+        // Read-only, shared between threads
+        struct curl_slist* list() const { return m_list; }
+
+    private:
+        HeaderFields m_fields;
+        struct curl_slist* m_list;
+    };
+
     HttpRequest();
 
-    void setUrl(const std::string& u);
-    std::string getUrl() const;
+    void setUrl(std::string u);
+    const std::string& getUrl() const;
 
     void setMethod(HttpMethod m);
     HttpMethod getMethod() const;
 
-    void setBody(const std::string& b);
+    void setBody(std::string b);
     void setBody(const std::vector<u8>& data);
-    std::string getBody() const;
+    const std::string& getBody() const;
 
     void setMimeType(MimeType type);
     void applyMimeType();
     MimeType getMimeType() const;
 
-    void setHeader(const std::string& key, const std::string& value);
-    static void setHeader(HeaderFields& headers, const std::string& key, const std::string& value);
-    void setHeaders(const HeaderFields& newHeaders);
+    // Per-request headers, they must not repeat one of the base headers
+    void setHeader(std::string_view key, std::string value);
+    static void setHeader(HeaderFields& headers, std::string_view key, std::string value);
+    void setHeaders(HeaderFields newHeaders);
     const std::vector<std::pair<std::string, std::string>>& getHeaders() const;
 
-    void setQueryParam(const std::string& key, const std::string& value);
-    void setQueryParams(const std::vector<std::pair<std::string, std::string>>& params);
+    void setBaseHeaders(std::shared_ptr<const BaseHeaders> headers);
+    const std::shared_ptr<const BaseHeaders>& getBaseHeaders() const;
+
+    // Parameters that are the same for every request of a route, already encoded
+    // ("offset=0&limit=150"). They go in front of the others and are copied as they are.
+    // encoded has to outlive the request, use a literal.
+    void setStaticQuery(std::string_view encoded);
+    void setQueryParam(std::string_view key, std::string value);
+    void setQueryParams(std::vector<std::pair<std::string, std::string>> params);
+    // Without the static ones
     const std::vector<std::pair<std::string, std::string>>& getQueryParams() const;
+    // Value of a parameter, static ones included
+    std::optional<std::string> getQueryParam(std::string_view key) const;
 
     std::string buildUrlWithParams() const;
 
@@ -62,8 +97,13 @@ public:
     static std::string httpMethodToString(HttpMethod method);
 
 private:
+    // Moves the static parameters to the others, so one of them can be changed
+    void expandStaticQuery();
+
     std::string m_url;
     HeaderFields m_headers;
+    std::shared_ptr<const BaseHeaders> m_baseHeaders;
+    std::string_view m_staticQuery;
     std::vector<std::pair<std::string, std::string>> m_queryParams;
     std::string m_body;
     MimeType m_mime;
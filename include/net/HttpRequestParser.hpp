@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Incremental parser for the requests of one client connection. It remembers how far
+// it got, so every parse() only looks at the bytes that arrived since the last one.
+// Nothing is copied or allocated, the accessors return views into the buffer.
+
+class HttpRequestParser {
+public:
+    static constexpr size_t MaxHeadBytes = 16 * 1024;   // request line + headers
+    static constexpr size_t MaxHeaders = 64;
+    static constexpr size_t MaxBodyBytes = 64 * 1024;   // our routes only get URLs and ID lists
+
+    enum class Result {
+        Incomplete,     // wait for more data
+        Complete,
+        Malformed,
+        HeadTooLarge,
+        BodyTooLarge,
+    };
+
+    HttpRequestParser();
+
+    // buffer has to start with the request and may only have grown since the last call.
+    // Once Complete is returned, the same result is returned until reset().
+    Result parse(const std::string& buffer);
+    // For the next request, after the current one was removed from the front of the buffer
+    void reset();
+
+    // Valid after Complete, until the buffer changes
+    std::string_view method() const { return view(m_method); }
+    std::string_view target() const { return view(m_target); }  // path + query
+    std::string_view path() const;
+    std::string_view query() const;                              // without the '?'
+    std::string_view body() const { return view(m_body); }
+    bool isHttp11() const { return m_http11; }
+    // Value of the first header with that name (case-insensitive), trimmed
+    std::optional<std::string_view> header(std::string_view name) const;
+    // Head and body, the bytes to remove from the buffer
+    size_t length() const { return m_body.offset + m_body.size; }
+
+private:
+    enum class State { RequestLine, Headers, Body, Done };
+
+    struct Span {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    struct Header {
+        Span name;
+        Span value;
+    };
+
+    std::string_view view(Span span) const { return std::string_view(m_data + span.offset, span.size); }
+    bool parseRequestLine(size_t start, size_t end);
+    bool parseHeader(size_t start, size_t end);
+    // Content-Length, checked once the head is complete
+    Result startBody(size_t headEnd);
+
+    const char* m_data;
+    State m_state;
+    size_t m_lineStart;     // first byte of the line being scanned
+    size_t m_scan;          // next byte to look at for its end
+    Span m_method;
+    Span m_target;
+    Span m_body;
+    bool m_http11;
+    std::array<Header, MaxHeaders> m_headers;
+    size_t m_headerCount;
+};
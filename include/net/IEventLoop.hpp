@@ -0,0 +1,13 @@
+#pragma once
+
+// Something that can be driven by a ServerThread
+
+class IEventLoop {
+public:
+    virtual ~IEventLoop() = default;
+    // Runs one iteration, waiting up to timeoutMs (-1 = until something happens) for activity
+    virtual bool serverLoop(int timeoutMs) = 0;
+    // Thread-safe, wakes up a blocking serverLoop() and makes isRunning() return false
+    virtual void stop() = 0;
+    virtual bool isRunning() const = 0;
+};
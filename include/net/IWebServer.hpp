@@ -1,16 +1,17 @@
 #pragma once
 
+#include "IEventLoop.hpp"
+
 #include <switch/types.h>
 
 #include <string>
 
 // Generic WebServer Interface
 
-class IWebServer {
+class IWebServer : public IEventLoop {
 public:
     virtual ~IWebServer() = default;
     virtual bool start(u16 port) = 0;
-    virtual bool serverLoop() = 0;
 
 protected:
     virtual void handleClient(int fd) = 0;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "HttpClient.hpp"
+
+#include <switch/types.h>
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Fetches several offset/limit pages of a dream_lands query at once and merges their
+// msgpack "dreams" arrays into one response, dropping dreams that show up twice.
+// The other fields of the response are taken from the first page.
+
+class PagedQuery {
+public:
+    static constexpr size_t MaxPages = 20;
+    // Upstream pages requested at the same time
+    static constexpr size_t MaxParallelPages = 3;
+
+    // body is the merged msgpack response
+    typedef std::function<void(bool success, const std::string& contentType, std::string body)> DoneFunc;
+
+    // firstPage must carry the offset and limit query parameters
+    PagedQuery(HttpClient& client, const HttpRequest& firstPage, size_t pages, size_t maxResults, DoneFunc done);
+    // Cancels the pages that are still running
+    ~PagedQuery();
+
+    // Number of pages asked for with pages= and max_results=, 0 if neither was given.
+    // maxResults is 0 without a limit.
+    static size_t requestedPages(const std::unordered_map<std::string, std::string>& queryParams, size_t pageSize, size_t& maxResults);
+    // The limit query parameter of a request, 0 if it has none
+    static size_t pageSizeOf(const HttpRequest& request);
+
+    void start();
+    bool isDone() const { return m_done; }
+
+private:
+    class PageSink;
+
+    struct Page {
+        bool done = false;
+        bool ok = false;
+        std::string body;
+        std::string contentType;
+    };
+
+    void startPages();
+    void onPageDone(size_t page, bool success, std::string contentType, std::string body);
+    // Returns false if the first page isn't a msgpack map
+    bool merge(std::string& out) const;
+    void finish(bool success);
+
+    HttpClient& m_client;
+    HttpRequest m_firstPage;
+    size_t m_pageSize;
+    size_t m_firstOffset;
+    size_t m_maxResults;
+    DoneFunc m_doneCallback;
+
+    std::vector<Page> m_pages;
+    // pages after a short one are past the end of the result
+    size_t m_pageLimit;
+    size_t m_nextPage;
+    size_t m_running;
+    std::vector<HttpClient::TransferHandle> m_transfers;
+    bool m_closing;
+    bool m_done;
+};
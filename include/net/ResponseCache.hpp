@@ -0,0 +1,62 @@
+#pragma once
+
+#include "HttpClient.hpp"
+
+#include <switch/types.h>
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Byte-bounded LRU cache of complete upstream responses, keyed by the normalized
+// upstream request (method + full URL). Entries expire after the TTL of their route.
+// Shared by all workers.
+
+class ResponseCache {
+public:
+    struct Entry {
+        std::string contentType;
+        std::string body;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Stats {
+        u64 hits = 0;
+        u64 misses = 0;
+        u64 bypasses = 0;   // lookups skipped because the client asked for a fresh response
+        u64 evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    ResponseCache(size_t maxBytes, size_t maxEntryBytes);
+
+    static std::string makeKey(const HttpRequest& request);
+
+    std::shared_ptr<const Entry> get(const std::string& key);
+    void put(const std::string& key, std::string contentType, std::string body, std::chrono::seconds ttl);
+    void countBypass();
+
+    // Captures a relayed response and stores it once it completed with 200
+    std::unique_ptr<HttpClient::Sink> createFillSink(const std::string& key, std::chrono::seconds ttl);
+
+    Stats getStats() const;
+
+private:
+    class FillSink;
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<const Entry>>> LruList;
+
+    void evict(LruList::iterator it);
+
+    size_t m_maxBytes;
+    size_t m_maxEntryBytes;
+
+    mutable std::mutex m_mutex;
+    LruList m_lru; // most recently used first
+    std::unordered_map<std::string, LruList::iterator> m_index;
+    Stats m_stats;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "IEventLoop.hpp"
+
+#include <switch.h>
+
+#include <vector>
+
+// Runs a blocking IEventLoop::serverLoop() on its own libnx thread,
+// so accept latency and transfers don't depend on the UI frame pacing.
+
+class ServerThread {
+public:
+    static constexpr int AnyCore = -1;
+
+    ServerThread(IEventLoop& loop, int core = AnyCore);
+    ~ServerThread();
+
+    // Starts the thread on the requested core, AnyCore picks one other than the calling one
+    bool start();
+    // Stops the loop and joins the thread
+    void stop();
+
+    // Cores this process is allowed to run threads on
+    static std::vector<int> usableCores();
+
+private:
+    static void threadFunc(void* arg);
+    static int pickCore();
+
+    IEventLoop& m_loop;
+    int m_core;
+    Thread m_thread;
+    bool m_started;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <array>
+#include <mutex>
+#include <string>
+
+// CURLSH shared by the HttpClients of all worker threads, with the lock callbacks curl
+// needs for that. Only SSL sessions and DNS are shared: curl does not support sharing
+// a connection cache between concurrent threads, so every worker keeps the connections
+// of its own multi handle.
+// The CA bundle is read once and handed to every easy handle from memory.
+
+class SharedCurlCache {
+public:
+    SharedCurlCache();
+    ~SharedCurlCache();
+
+    SharedCurlCache(const SharedCurlCache&) = delete;
+    SharedCurlCache& operator=(const SharedCurlCache&) = delete;
+
+    CURLSH* handle() const { return m_shared; }
+    // Empty if curl has no CA bundle file configured, curl's defaults apply then
+    const std::string& caBundle() const { return m_caBundle; }
+
+private:
+    static void lockCallback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlockCallback(CURL* handle, curl_lock_data data, void* userptr);
+    void loadCaBundle();
+
+    CURLSH* m_shared;
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> m_locks;
+    std::string m_caBundle;
+};
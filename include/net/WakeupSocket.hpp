@@ -0,0 +1,22 @@
+#pragma once
+
+#include <netinet/in.h>
+
+// Loopback UDP socket to put into a poll set, wake() sends a datagram to it
+// so a blocking poll() returns. Safe to call wake() from any thread.
+
+class WakeupSocket {
+public:
+    WakeupSocket();
+    ~WakeupSocket();
+
+    bool open();
+    int fd() const { return m_fd; }
+    void wake();
+    // Reads all pending wakeups, call when poll reported the fd readable
+    void drain();
+
+private:
+    int m_fd;
+    sockaddr_in m_addr;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Per-worker queue of pending work. The owning worker pops from the back,
+// idle workers steal from the front of a busy worker's queue.
+
+template <typename T>
+class WorkStealingQueue {
+public:
+    void push(T item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.push_back(std::move(item));
+    }
+
+    std::optional<T> pop() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return std::nullopt;
+        T item = std::move(m_items.back());
+        m_items.pop_back();
+        return item;
+    }
+
+    std::optional<T> steal() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_items.empty()) return std::nullopt;
+        T item = std::move(m_items.front());
+        m_items.pop_front();
+        return item;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::deque<T> m_items;
+};
@@ -0,0 +1,260 @@
+#include <helpers/Msgpack.hpp>
+
+MsgpackReader::MsgpackReader(const char* data, size_t size)
+    : m_data(reinterpret_cast<const u8*>(data)),
+      m_size(size),
+      m_offset(0) {}
+
+bool MsgpackReader::readLength(size_t bytes, u64& out) {
+    if (m_size - m_offset < bytes) return false;
+    out = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        out = (out << 8) | m_data[m_offset++];
+    }
+    return true;
+}
+
+bool MsgpackReader::advance(u64 bytes) {
+    if (m_size - m_offset < bytes) return false;
+    m_offset += bytes;
+    return true;
+}
+
+bool MsgpackReader::readArrayHeader(u32& count) {
+    if (atEnd()) return false;
+    u8 type = m_data[m_offset];
+    u64 n = 0;
+    if (0x90 == (type & 0xF0)) {
+        m_offset++;
+        n = type & 0x0F;
+    }
+    else if (0xDC == type || 0xDD == type) {
+        m_offset++;
+        if (!readLength(0xDC == type ? 2 : 4, n)) return false;
+    }
+    else {
+        return false;
+    }
+    count = static_cast<u32>(n);
+    return true;
+}
+
+bool MsgpackReader::readMapHeader(u32& count) {
+    if (atEnd()) return false;
+    u8 type = m_data[m_offset];
+    u64 n = 0;
+    if (0x80 == (type & 0xF0)) {
+        m_offset++;
+        n = type & 0x0F;
+    }
+    else if (0xDE == type || 0xDF == type) {
+        m_offset++;
+        if (!readLength(0xDE == type ? 2 : 4, n)) return false;
+    }
+    else {
+        return false;
+    }
+    count = static_cast<u32>(n);
+    return true;
+}
+
+bool MsgpackReader::readString(std::string& out) {
+    if (atEnd()) return false;
+    u8 type = m_data[m_offset];
+    u64 length = 0;
+    if (0xA0 == (type & 0xE0)) {
+        m_offset++;
+        length = type & 0x1F;
+    }
+    else if (0xD9 <= type && type <= 0xDB) {
+        m_offset++;
+        if (!readLength(size_t(1) << (type - 0xD9), length)) return false;
+    }
+    else {
+        return false;
+    }
+    if (m_size - m_offset < length) return false;
+    out.assign(reinterpret_cast<const char*>(m_data + m_offset), length);
+    m_offset += length;
+    return true;
+}
+
+bool MsgpackReader::readInt(s64& out) {
+    if (atEnd()) return false;
+    u8 type = m_data[m_offset];
+    if (type <= 0x7F) {
+        m_offset++;
+        out = type;
+        return true;
+    }
+    if (type >= 0xE0) {
+        m_offset++;
+        out = static_cast<s8>(type);
+        return true;
+    }
+
+    u64 value = 0;
+    if (0xCC <= type && type <= 0xCF) {
+        // uint 8 - 64
+        m_offset++;
+        if (!readLength(size_t(1) << (type - 0xCC), value)) return false;
+        out = static_cast<s64>(value);
+        return true;
+    }
+    if (0xD0 <= type && type <= 0xD3) {
+        // int 8 - 64, sign extend
+        size_t bytes = size_t(1) << (type - 0xD0);
+        m_offset++;
+        if (!readLength(bytes, value)) return false;
+        u32 shift = 64 - 8 * bytes;
+        out = static_cast<s64>(value << shift) >> shift;
+        return true;
+    }
+    return false;
+}
+
+bool MsgpackReader::skip() {
+    // values still to skip, containers add their elements instead of recursing
+    u64 pending = 1;
+    while (pending > 0) {
+        if (atEnd()) return false;
+        pending--;
+        u8 type = m_data[m_offset++];
+        u64 n = 0;
+
+        if (type <= 0x7F || type >= 0xE0) continue;        // fixint
+        if (0x80 == (type & 0xF0)) { pending += 2 * (type & 0x0F); continue; } // fixmap
+        if (0x90 == (type & 0xF0)) { pending += type & 0x0F; continue; }      // fixarray
+        if (0xA0 == (type & 0xE0)) { if (!advance(type & 0x1F)) return false; continue; } // fixstr
+
+        switch (type) {
+            case 0xC0: case 0xC2: case 0xC3:    // nil, false, true
+                break;
+            case 0xC4: case 0xC5: case 0xC6:    // bin 8 - 32
+                if (!readLength(size_t(1) << (type - 0xC4), n) || !advance(n)) return false;
+                break;
+            case 0xC7: case 0xC8: case 0xC9:    // ext 8 - 32
+                if (!readLength(size_t(1) << (type - 0xC7), n) || !advance(n + 1)) return false;
+                break;
+            case 0xCA: if (!advance(4)) return false; break;    // float 32
+            case 0xCB: if (!advance(8)) return false; break;    // float 64
+            case 0xCC: case 0xCD: case 0xCE: case 0xCF:         // uint 8 - 64
+                if (!advance(size_t(1) << (type - 0xCC))) return false;
+                break;
+            case 0xD0: case 0xD1: case 0xD2: case 0xD3:         // int 8 - 64
+                if (!advance(size_t(1) << (type - 0xD0))) return false;
+                break;
+            case 0xD4: case 0xD5: case 0xD6: case 0xD7: case 0xD8: // fixext 1 - 16
+                if (!advance(1 + (size_t(1) << (type - 0xD4)))) return false;
+                break;
+            case 0xD9: case 0xDA: case 0xDB:    // str 8 - 32
+                if (!readLength(size_t(1) << (type - 0xD9), n) || !advance(n)) return false;
+                break;
+            case 0xDC: case 0xDD:               // array 16 / 32
+                if (!readLength(0xDC == type ? 2 : 4, n)) return false;
+                pending += n;
+                break;
+            case 0xDE: case 0xDF:               // map 16 / 32
+                if (!readLength(0xDE == type ? 2 : 4, n)) return false;
+                pending += 2 * n;
+                break;
+            default:                            // 0xC1 is never used
+                return false;
+        }
+    }
+    return true;
+}
+
+bool MsgpackReader::findKey(const std::string& key) {
+    u32 count = 0;
+    if (!readMapHeader(count)) return false;
+    for (u32 i = 0; i < count; i++) {
+        std::string name;
+        size_t keyStart = m_offset;
+        if (readString(name)) {
+            if (name == key) return true;
+        }
+        else {
+            // non-string key
+            m_offset = keyStart;
+            if (!skip()) return false;
+        }
+        if (!skip()) return false;
+    }
+    return false;
+}
+
+void MsgpackWriter::writeBigEndian(u64 value, size_t bytes) {
+    for (size_t i = bytes; i > 0; i--) {
+        m_out.push_back(static_cast<char>((value >> (8 * (i - 1))) & 0xFF));
+    }
+}
+
+void MsgpackWriter::writeArrayHeader(u32 count) {
+    if (count < 16) {
+        m_out.push_back(static_cast<char>(0x90 | count));
+    }
+    else if (count <= 0xFFFF) {
+        m_out.push_back(static_cast<char>(0xDC));
+        writeBigEndian(count, 2);
+    }
+    else {
+        m_out.push_back(static_cast<char>(0xDD));
+        writeBigEndian(count, 4);
+    }
+}
+
+void MsgpackWriter::writeMapHeader(u32 count) {
+    if (count < 16) {
+        m_out.push_back(static_cast<char>(0x80 | count));
+    }
+    else if (count <= 0xFFFF) {
+        m_out.push_back(static_cast<char>(0xDE));
+        writeBigEndian(count, 2);
+    }
+    else {
+        m_out.push_back(static_cast<char>(0xDF));
+        writeBigEndian(count, 4);
+    }
+}
+
+void MsgpackWriter::writeString(const std::string& value) {
+    size_t length = value.size();
+    if (length < 32) {
+        m_out.push_back(static_cast<char>(0xA0 | length));
+    }
+    else if (length <= 0xFF) {
+        m_out.push_back(static_cast<char>(0xD9));
+        writeBigEndian(length, 1);
+    }
+    else if (length <= 0xFFFF) {
+        m_out.push_back(static_cast<char>(0xDA));
+        writeBigEndian(length, 2);
+    }
+    else {
+        m_out.push_back(static_cast<char>(0xDB));
+        writeBigEndian(length, 4);
+    }
+    m_out.append(value);
+}
+
+void MsgpackWriter::writeInt(s64 value) {
+    if (value >= 0 && value <= 0x7F) {
+        m_out.push_back(static_cast<char>(value));
+    }
+    else if (value < 0 && value >= -32) {
+        m_out.push_back(static_cast<char>(value));
+    }
+    else if (value >= 0) {
+        m_out.push_back(static_cast<char>(0xCF));
+        writeBigEndian(static_cast<u64>(value), 8);
+    }
+    else {
+        m_out.push_back(static_cast<char>(0xD3));
+        writeBigEndian(static_cast<u64>(value), 8);
+    }
+}
+
+void MsgpackWriter::writeRaw(const char* data, size_t size) {
+    m_out.append(data, size);
+}
@@ -0,0 +1,83 @@
+#include <helpers/StatusQueue.hpp>
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+StatusQueue::StatusQueue()
+    : m_enqueuePos(0),
+      m_dequeuePos(0) {
+    static_assert(0 == (Capacity & (Capacity - 1)), "Capacity must be a power of two");
+    for (size_t i = 0; i < Capacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+StatusQueue::Cell* StatusQueue::acquireCell() {
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell* cell = &m_cells[pos & (Capacity - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (0 == diff) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                return cell;
+            }
+        }
+        else if (diff < 0) {
+            // full
+            return nullptr;
+        }
+        else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void StatusQueue::publishCell(Cell* cell) {
+    size_t seq = cell->sequence.load(std::memory_order_relaxed);
+    cell->sequence.store(seq + 1, std::memory_order_release);
+}
+
+bool StatusQueue::push(const char* text) {
+    Cell* cell = acquireCell();
+    if (!cell) return false;
+    strncpy(cell->message.text, text, MessageSize - 1);
+    cell->message.text[MessageSize - 1] = '\0';
+    publishCell(cell);
+    return true;
+}
+
+bool StatusQueue::pushf(const char* fmt, ...) {
+    Cell* cell = acquireCell();
+    if (!cell) return false;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(cell->message.text, MessageSize, fmt, args);
+    va_end(args);
+    publishCell(cell);
+    return true;
+}
+
+bool StatusQueue::pop(Message& out) {
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell* cell = &m_cells[pos & (Capacity - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (0 == diff) {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                out = cell->message;
+                cell->sequence.store(pos + Capacity, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            // empty
+            return false;
+        }
+        else {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
@@ -1,4 +1,5 @@
 #include <net/AcbaaWebServer.hpp>
+#include <net/ServerThread.hpp>
 
 #include <arpa/inet.h>
 #include <sys/fcntl.h>
@@ -6,36 +7,18 @@
 #include <poll.h>
 
 #include <cstring>
+#include <cstdarg>
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <tuple>
+#include <array>
+#include <span>
+#include <string_view>
 
 namespace {
-    // https://www.geeksforgeeks.org/cpp/how-to-split-cpp-string-into-vector-of-substrings/
-    std::vector<std::string> splitString(std::string& input, char delimiter)
-    {
-    
-        // Creating an input string stream from the input string
-        std::istringstream stream(input);
-    
-        // Vector to store the tokens
-        std::vector<std::string> tokens;
-    
-        // Temporary string to store each token
-        std::string token;
-    
-        // Read tokens from the string stream separated by the
-        // delimiter
-        while (getline(stream, token, delimiter)) {
-            // Add the token to the vector of tokens
-            tokens.push_back(token);
-        }
-    
-        // Return the vector of tokens
-        return tokens;
-    }
-    
     void extractQueryParams(std::string& uri, std::unordered_map<std::string, std::string>& queryParams) {
         // Parse query parameters if any
         size_t qPos = uri.find('?');
@@ -85,18 +68,205 @@ namespace {
         int flags = fcntl(fd, F_GETFL, 0);
         return (flags != -1) && (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1);
     }
+
+    typedef std::unordered_map<std::string, std::string> QueryParams;
+    typedef std::optional<HttpRequest> (*RequestBuilder)(const std::string& baseUrl, const std::string& body, const QueryParams& params);
+
+    // Fixed parameters of the dream_lands queries, encoded once here instead of on every request
+    constexpr std::string_view dreamQueryFirstPage = "offset=0&limit=150";
+    constexpr std::string_view dreamQueryByName = "offset=0&limit=150&q%5Bsearch_type%5D=name";
+    constexpr std::string_view dreamQueryRecommended = "offset=0&limit=150&q%5Bsearch_type%5D=recommend";
+
+    // Builders for /dream_lands
+    std::optional<HttpRequest> buildDreamQueryById(const std::string& baseUrl, const std::string& body, const QueryParams& params) {
+        HttpRequest req;
+        req.setMethod(HttpRequest::HttpMethod::Get);
+        req.setUrl(baseUrl + "/api/v1/dream_lands");
+        req.setMimeType(HttpRequest::MimeType::Msgpack);
+        req.setStaticQuery(dreamQueryFirstPage);
+        req.setQueryParams({
+            {"q[id]", params.at("id")}
+        });
+        return req;
+    }
+
+    std::optional<HttpRequest> buildDreamQueryByLandName(const std::string& baseUrl, const std::string& body, const QueryParams& params) {
+        HttpRequest req;
+        req.setMethod(HttpRequest::HttpMethod::Get);
+        req.setUrl(baseUrl + "/api/v1/dream_lands");
+        req.setMimeType(HttpRequest::MimeType::Msgpack);
+        req.setStaticQuery(dreamQueryByName);
+        req.setQueryParams({
+            {"q[land_name]", params.at("land_name")}
+        });
+        return req;
+    }
+
+    std::optional<HttpRequest> buildDreamQueryRecommended(const std::string& baseUrl, const std::string& body, const QueryParams& params) {
+        if (params.end() == params.find("lang")) {
+            return std::nullopt;
+        }
+        HttpRequest req;
+        req.setMethod(HttpRequest::HttpMethod::Get);
+        req.setUrl(baseUrl + "/api/v1/dream_lands");
+        req.setMimeType(HttpRequest::MimeType::Msgpack);
+        req.setStaticQuery(dreamQueryRecommended);
+        req.setQueryParams({
+            {"q[lang]", params.at("lang")}
+        });
+        return req;
+    }
+
+    // Builders for /dream_land/
+    std::optional<HttpRequest> buildDreamDownload(const std::string& baseUrl, const std::string& body, const QueryParams& params) {
+        if (body.empty()) {
+            return std::nullopt;
+        }
+        std::string url = body;
+        // m_baseUrl has to be used. I know this can be circumvented by sending requests to 
+        // $m_baseUrl.mySubdomain.wowMomImAHacker.org, but at that point, I don't care enough
+        // about implementing security checks.
+        if (0 != url.rfind(baseUrl, 0)) {
+            return std::nullopt; 
+        }
+        std::vector<std::pair <std::string, std::string>> dreamDownloadQuery;
+        extractQueryParams(url, dreamDownloadQuery);
+        HttpRequest req;
+        req.setMethod(HttpRequest::HttpMethod::Get);
+        req.setUrl(std::move(url));
+        req.setQueryParams(std::move(dreamDownloadQuery));
+        return req;
+    }
+
+    // Builders for /friend_requests
+    std::optional<HttpRequest> buildFriendRequests(const std::string& baseUrl, const std::string& body, const QueryParams& params) {
+        if ("receive" != params.at("type") && "send" != params.at("type")) {
+            return std::nullopt; 
+        }
+        HttpRequest req;
+        req.setMethod(HttpRequest::HttpMethod::Get);
+        req.setUrl(baseUrl + "/api/v1/friend_requests");
+        req.setQueryParams({
+            {"type", params.at("type")},
+        });
+        return req;
+    }
+
+    // Used if the client sent this query parameter, an empty one always matches
+    struct RouteVariant {
+        std::string_view param;
+        RequestBuilder build;
+    };
+
+    enum RouteFlags : u32 {
+        RouteNoAuthorization = 1 << 0, // upstream doesn't get the bearer token
+        RouteStoresBlobs     = 1 << 1, // responses are kept in the blob store
+        RouteForwardsRanges  = 1 << 2, // Range/If-Range of the client go upstream
+        RoutePaged           = 1 << 3, // upstream is paged with offset/limit
+    };
+
+    struct Route {
+        std::string_view path;
+        std::span<const RouteVariant> variants; // the first match wins
+        u32 cacheTtlSeconds;                    // 0 = not cached
+        u32 flags;
+    };
+
+    // A request with both id and land_name is looked up by id
+    constexpr RouteVariant dreamQueryVariants[] = {
+        { "id", buildDreamQueryById },
+        { "land_name", buildDreamQueryByLandName },
+        { "recommend", buildDreamQueryRecommended },
+    };
+    constexpr RouteVariant dreamDownloadVariants[] = {
+        { "", buildDreamDownload },
+    };
+    constexpr RouteVariant friendRequestsVariants[] = {
+        { "type", buildFriendRequests },
+    };
+
+    constexpr Route routes[] = {
+        // Clients tend to repeat the same lookups while retrying, answer those from memory for a while.
+        // pages= / max_results= fetch more than the first 150 results
+        { "/dream_query", dreamQueryVariants, 60, RoutePaged },
+        // Downloads don't need Authorization: Bearer .... Dream bodies and meta blobs
+        // don't change, keep them on the SD card; clients may resume interrupted downloads
+        { "/dream_download", dreamDownloadVariants, 0, RouteNoAuthorization | RouteStoresBlobs | RouteForwardsRanges },
+        { "/friend_requests", friendRequestsVariants, 0, 0 },
+    };
+
+    // Paths are found through a perfect hash over this many slots, checked at compile time
+    constexpr size_t routeSlotCount = 16;
+
+    constexpr size_t routeSlot(std::string_view path) {
+        // FNV-1a
+        u32 hash = 2166136261u;
+        for (char c : path) {
+            hash = (hash ^ static_cast<u8>(c)) * 16777619u;
+        }
+        return hash % routeSlotCount;
+    }
+
+    constexpr std::array<s8, routeSlotCount> buildRouteSlots() {
+        std::array<s8, routeSlotCount> slots{};
+        slots.fill(-1);
+        for (size_t i = 0; i < std::size(routes); i++) {
+            slots[routeSlot(routes[i].path)] = static_cast<s8>(i);
+        }
+        return slots;
+    }
+
+    constexpr std::array<s8, routeSlotCount> routeSlots = buildRouteSlots();
+
+    constexpr bool routeSlotsAreUnique() {
+        for (size_t i = 0; i < std::size(routes); i++) {
+            if (routeSlots[routeSlot(routes[i].path)] != static_cast<s8>(i)) return false;
+        }
+        return true;
+    }
+    static_assert(routeSlotsAreUnique(), "two routes share a slot, change routeSlotCount");
+
+    const Route* findRoute(std::string_view path) {
+        s8 index = routeSlots[routeSlot(path)];
+        if (index < 0 || routes[index].path != path) {
+            return nullptr;
+        }
+        return &routes[index];
+    }
+
+    bool routeHasFlag(std::string_view path, u32 flag) {
+        const Route* route = findRoute(path);
+        return route && (route->flags & flag);
+    }
 }
 
 AcbaaWebServer::AcbaaWebServer(const std::string& bearerToken)
     : m_serverFd(-1),
       m_running(false),
+      m_statusQueue(nullptr),
+      m_nextWorker(0),
       m_bearerToken(bearerToken),
       m_userAgent("libcurl/7.64.1 (HAC; nnEns; SDK 20.5.4.0)"),
-      m_baseUrl("https://api.hac.lp1.acbaa.srv.nintendo.net") {
-    initRouteRequestBuilders();
-}
+      m_baseUrl("https://api.hac.lp1.acbaa.srv.nintendo.net"),
+      m_baseHeaders(std::make_shared<const HttpRequest::BaseHeaders>(HttpRequest::HeaderFields{
+          { "User-Agent", m_userAgent },
+          { "Accept", "*/*" },
+      })),
+      m_authorizedBaseHeaders(std::make_shared<const HttpRequest::BaseHeaders>(HttpRequest::HeaderFields{
+          { "User-Agent", m_userAgent },
+          { "Accept", "*/*" },
+          { "Authorization", "Bearer " + m_bearerToken },
+      })),
+      m_responseCache(2 * 1024 * 1024, 512 * 1024) {}
 
 AcbaaWebServer::~AcbaaWebServer() {
+    stop();
+    // join the worker threads before their workers go away
+    m_workerThreads.clear();
+    m_workers.clear();
+    if (m_serverFd >= 0) {
+        close(m_serverFd);
+    }
 }
 
 bool AcbaaWebServer::start(u16 port) {
@@ -130,311 +300,225 @@ bool AcbaaWebServer::start(u16 port) {
     // Start listening to the socket with 5 maximum parallel connections
     if (listen(m_serverFd, 10) < 0) return false;
 
+    if (!m_wakeup.open()) return false;
+    if (!startWorkers()) return false;
+
     m_running = true;
     return true;
 }
 
-bool AcbaaWebServer::serverLoop() {
-    if (m_serverFd < 0)
+bool AcbaaWebServer::startWorkers() {
+    // One worker per core we may use, each with its own multi handle and connection cache,
+    // SSL sessions and DNS are shared between them
+    std::vector<int> cores = ServerThread::usableCores();
+    size_t workerCount = std::max<size_t>(1, cores.size());
+    auto cache = std::make_shared<SharedCurlCache>();
+
+    std::vector<AcbaaWorker*> peers;
+    for (size_t i = 0; i < workerCount; i++) {
+        auto worker = std::make_unique<AcbaaWorker>(*this, cache);
+        if (!worker->open()) return false;
+        peers.push_back(worker.get());
+        m_workers.push_back(std::move(worker));
+    }
+    for (auto& worker : m_workers) {
+        worker->setPeers(peers);
+    }
+
+    for (size_t i = 0; i < workerCount; i++) {
+        int core = cores.empty() ? ServerThread::AnyCore : cores[i % cores.size()];
+        auto thread = std::make_unique<ServerThread>(*m_workers[i], core);
+        if (!thread->start()) return false;
+        m_workerThreads.push_back(std::move(thread));
+    }
+    reportStatus("Started %zu worker(s)", workerCount);
+    return true;
+}
+
+void AcbaaWebServer::stop() {
+    m_running = false;
+    m_wakeup.wake();
+    for (auto& worker : m_workers) {
+        worker->stop();
+    }
+}
+
+bool AcbaaWebServer::isRunning() const {
+    return m_running;
+}
+
+void AcbaaWebServer::setStatusQueue(StatusQueue* queue) {
+    m_statusQueue = queue;
+}
+
+void AcbaaWebServer::reportStatus(const char* fmt, ...) {
+    char text[StatusQueue::MessageSize];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+
+    if (m_statusQueue) {
+        m_statusQueue->push(text);
+    }
+    else {
+        printf("%s\n", text);
+    }
+}
+
+bool AcbaaWebServer::serverLoop(int timeoutMs) {
+    if (m_serverFd < 0 || !m_running)
         return false;
 
-    pollfd pfd = { .fd = m_serverFd, .events = POLLIN, .revents = 0 };
+    // The acceptor only waits for new connections, the workers do the rest
+    pollfd pfds[2] = {
+        { .fd = m_serverFd, .events = POLLIN, .revents = 0 },
+        { .fd = m_wakeup.fd(), .events = POLLIN, .revents = 0 },
+    };
 
-    // Non-blocking poll with no timeout
-    int ret = poll(&pfd, 1, 0);
+    int ret = poll(pfds, 2, timeoutMs);
     if (ret < 0) {
-        perror("poll");
+        if (errno == EINTR) return true;
+        reportStatus("poll failed: %s", strerror(errno));
         return false;
     }
-    if (ret == 0) {
-        // no incoming connection this iteration
-        return true;
+    if (pfds[1].revents & POLLIN) {
+        m_wakeup.drain();
+    }
+
+    // Incoming connections ready
+    if (pfds[0].revents & POLLIN) {
+        acceptClients();
     }
 
-    // Incoming connection ready
-    if (pfd.revents & POLLIN) {
+    return true;
+}
+
+void AcbaaWebServer::acceptClients() {
+    while (true) {
         sockaddr_in clientAddr{};
         socklen_t addrLen = sizeof(clientAddr);
         int clientFd = accept(m_serverFd, (sockaddr*)&clientAddr, &addrLen);
         if (clientFd < 0) {
-            perror("accept");
-            return true;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                reportStatus("accept failed: %s", strerror(errno));
+            }
+            return;
+        }
+        if (!setNonBlocking(clientFd)) {
+            close(clientFd);
+            continue;
         }
-        
-        printf("Accepted connection from %s:%u\n", inet_ntoa(clientAddr.sin_addr), ntohs(clientAddr.sin_port));
 
-        // Handle the entire request + streaming in one shot
+        reportStatus("Accepted connection from %s:%u", inet_ntoa(clientAddr.sin_addr), ntohs(clientAddr.sin_port));
         handleClient(clientFd);
-
-        close(clientFd);
-        printf("Closed connection (fd=%d)\n", clientFd);
     }
-
-    return true;
 }
 
-std::tuple<std::string,std::string,std::string,std::unordered_map<std::string,std::string>>
-AcbaaWebServer::parseHttpRequest(const std::string& fullReq) {
-    // 1) Find end of headers
-    auto hdrEnd = fullReq.find("\r\n\r\n");
-    if (hdrEnd == std::string::npos) {
-        throw std::runtime_error("Malformed request: no header terminator");
+void AcbaaWebServer::handleClient(int clientFd) {
+    if (m_workers.empty()) {
+        close(clientFd);
+        return;
     }
 
-    // 2) Extract headers block
-    std::string headers = fullReq.substr(0, hdrEnd);
-    std::string postBody;
-    size_t bodyLen = 0;
-
-    // 3) Parse Content-Length, if any
-    {
-        std::istringstream hs(headers);
-        std::string line;
-        while (std::getline(hs, line)) {
-            if (line.size() >= 15 && 
-                std::equal(line.begin(), line.begin()+15, "Content-Length:")) {
-                bodyLen = std::stoul(line.substr(15));
-                break;
-            }
+    // Least loaded worker, round robin between equally loaded ones.
+    // Idle workers steal from the queue if the chosen one is slow to pick it up.
+    AcbaaWorker* target = nullptr;
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        AcbaaWorker* worker = m_workers[(m_nextWorker + i) % m_workers.size()].get();
+        if (!target || worker->getLoad() < target->getLoad()) {
+            target = worker;
         }
     }
+    m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    target->assignConnection(clientFd);
+}
 
-    // 4) If there's a body, extract it
-    if (bodyLen > 0) {
-        size_t bodyStart = hdrEnd + 4;
-        if (fullReq.size() < bodyStart + bodyLen)
-            throw std::runtime_error("Malformed request: body shorter than Content-Length");
-        postBody = fullReq.substr(bodyStart, bodyLen);
+AcbaaWebServer::RouteResult AcbaaWebServer::buildRequest(
+    std::string_view route,
+    const std::string& body,
+    const std::unordered_map<std::string, std::string>& queryParams,
+    HttpRequest& request) const {
+    const Route* routeEntry = findRoute(route);
+    if (!routeEntry) {
+        return RouteResult::NotFound;
     }
 
-    // 5) Parse request-line (first line of headers)
-    auto lineEnd = headers.find("\r\n");
-    std::string requestLine = headers.substr(0, lineEnd);
-    auto parts = splitString(requestLine, ' ');
-    if (parts.size() != 3)
-        throw std::runtime_error("Malformed request-line");
-
-    std::string method = parts[0];
-    std::string uri    = parts[1];
-
-    // 6) Extract query parameters from URI
-    std::unordered_map<std::string,std::string> queryParams;
-    auto qPos = uri.find('?');
-    if (qPos != std::string::npos) {
-        std::string qs = uri.substr(qPos+1);
-        uri = uri.substr(0, qPos);
-
-        size_t pos = 0;
-        while (pos < qs.size()) {
-            auto amp = qs.find('&', pos);
-            auto pair = qs.substr(pos, amp - pos);
-            auto eq = pair.find('=');
-            if (eq != std::string::npos) {
-                auto key = pair.substr(0, eq);
-                auto val = pair.substr(eq+1);
-                queryParams[key] = val;
+    for (const RouteVariant& variant : routeEntry->variants) {
+        bool matches = variant.param.empty() ||
+            std::any_of(queryParams.begin(), queryParams.end(), [&](const auto& param) { return variant.param == param.first; });
+        if (!matches) continue;
+
+        std::optional<HttpRequest> maybeRequest;
+        try {
+            maybeRequest = variant.build(m_baseUrl, body, queryParams);
+            if(!maybeRequest.has_value()) {
+                return RouteResult::BadRequest;
             }
-            if (amp == std::string::npos) break;
-            pos = amp + 1;
         }
+        catch(...) {
+            return RouteResult::BadRequest;
+        }
+        request = std::move(maybeRequest.value());
+        prepareRequest(request, !(routeEntry->flags & RouteNoAuthorization));
+        return RouteResult::Ok;
     }
 
-    return { method, uri, postBody, queryParams };
+    return RouteResult::BadRequest;
 }
 
-size_t AcbaaWebServer::parseContentLength(const std::string& headers) {
-    std::istringstream ss(headers);
-    std::string line;
-    const std::string key = "Content-Length:";
-    while (std::getline(ss, line)) {
-        if (line.size() >= key.size() &&
-            std::equal(key.begin(), key.end(), line.begin(),
-                       [](char a, char b){ return std::tolower(a)==std::tolower(b); }))
-        {
-            // skip past the header name and any whitespace
-            auto val = line.substr(key.size());
-            size_t pos = val.find_first_not_of(" \t");
-            if (pos != std::string::npos) val = val.substr(pos);
-            return std::stoul(val);
-        }
-    }
-    return 0;
+std::chrono::seconds AcbaaWebServer::getCacheTtl(std::string_view route) const {
+    const Route* routeEntry = findRoute(route);
+    return std::chrono::seconds(routeEntry ? routeEntry->cacheTtlSeconds : 0);
 }
 
-void AcbaaWebServer::handleClient(int clientFd) {
-    // 1) Read headers + body fully (as you already do with Content-Length)
-    std::string fullReq;
-    while (true) {
-        char buf[512];
-        ssize_t n = recv(clientFd, buf, sizeof(buf), 0);
-        if (n <= 0) break;  // EOF or error
-        fullReq.append(buf, n);
-        if (fullReq.find("\r\n\r\n") != std::string::npos) {
-            // parse Content-Length, wait until full body is in fullReq...
-            size_t hdrEnd = fullReq.find("\r\n\r\n");
-            size_t bodyLen = parseContentLength(fullReq.substr(0, hdrEnd));
-            if (fullReq.size() >= hdrEnd + 4 + bodyLen) break;
-        }
-    }
-
-    // 2) Parse out method, URI, postBody, queryParams...
-    auto [method, uri, postBody, queryParams] = parseHttpRequest(fullReq);
-
-    // 3) Dispatch to your existing handleRequest (which does the libcurl streaming)
-    handleRequest(uri, clientFd, postBody, queryParams);
-
-    // 4) Done: sendStreamingRequest will have written all bytes (blocking),
-    //    so when we return, it's safe to close() the socket.
+ResponseCache& AcbaaWebServer::getResponseCache() {
+    return m_responseCache;
 }
 
-void AcbaaWebServer::handleRequest(
-    const std::string& route,
-    int clientFd,
-    const std::string& body,
-    const std::unordered_map<std::string, std::string>& queryParams) {
-    auto routeIt = m_routeRequestBuilders.find(route);
-    if (routeIt == m_routeRequestBuilders.end()) {
-        sendNotFound(clientFd);
-        return;
-    }
+void AcbaaWebServer::setBlobStore(std::unique_ptr<BlobStore> store) {
+    m_blobStore = std::move(store);
+}
 
-    const auto& paramMap = routeIt->second;
-    for (const auto& [paramKey, builder] : paramMap) {
-        // For requests without params, we can define an empty string in m_routeRequestBuilders.
-        // TODO: find out if this is a bad way to set keys in hash maps.. (hash = 0)
-        if (paramKey.empty() || 0 == paramKey.compare("default") || 
-            queryParams.find(paramKey) != queryParams.end()) {
-            std::optional<HttpRequest> maybeRequest;
-            try {
-                maybeRequest = builder(body, queryParams);
-                if(!maybeRequest.has_value()) {
-                    sendBadRequest(clientFd);
-                    return;
-                }
-            }
-            catch(...) {
-                sendBadRequest(clientFd);
-                return;
-            }
-            HttpRequest request = maybeRequest.value();
-            prepareRequest(request, route);
-            sendStreamingRequest(request, clientFd, /*debug*/ false);
-            return;
-        }
-    }
+BlobStore* AcbaaWebServer::getBlobStore() {
+    return m_blobStore.get();
+}
 
-    sendBadRequest(clientFd);
+bool AcbaaWebServer::usesBlobStore(std::string_view route) const {
+    return routeHasFlag(route, RouteStoresBlobs);
 }
 
-void AcbaaWebServer::initRouteRequestBuilders() {
-    // Builders for /dream_lands
-    m_routeRequestBuilders["/dream_query"] = {
-        {"id", [this](const std::string& body, const auto& params) -> std::optional<HttpRequest> {
-            HttpRequest req;
-            req.setMethod(HttpRequest::HttpMethod::Get);
-            req.setUrl(m_baseUrl + "/api/v1/dream_lands");
-            req.setMimeType(HttpRequest::MimeType::Msgpack);
-            req.setQueryParams({
-                {"offset", "0"},
-                {"limit", "150"},
-                {"q[id]", params.at("id")}
-            });
-            return req;
-        }},
-        {"land_name", [this](const std::string& body, const auto& params) -> std::optional<HttpRequest> {
-            HttpRequest req;
-            req.setMethod(HttpRequest::HttpMethod::Get);
-            req.setUrl(m_baseUrl + "/api/v1/dream_lands");
-            req.setMimeType(HttpRequest::MimeType::Msgpack);
-            req.setQueryParams({
-                {"offset", "0"},
-                {"limit", "150"},
-                {"q[search_type]", "name"},
-                {"q[land_name]", params.at("land_name")}
-            });
-            return req;
-        }},
-        {"recommend", [this](const std::string& body, const auto& params) -> std::optional<HttpRequest> {
-            if (params.end() == params.find("lang")) {
-                return std::nullopt;
-            }
-            HttpRequest req;
-            req.setMethod(HttpRequest::HttpMethod::Get);
-            req.setUrl(m_baseUrl + "/api/v1/dream_lands");
-            req.setMimeType(HttpRequest::MimeType::Msgpack);
-            req.setQueryParams({
-                {"offset", "0"},
-                {"limit", "150"},
-                {"q[search_type]", "recommend"},
-                {"q[lang]", params.at("lang")}
-            });
-            return req;
-        }}
-    };
-    
-    // Builders for /dream_land/
-    m_routeRequestBuilders["/dream_download"] = {
-        {"default", [this](const std::string& body, const auto& params) -> std::optional<HttpRequest> {
-            if (body.empty()) {
-                return std::nullopt;
-            }
-            std::string url = body;
-            // m_baseUrl has to be used. I know this can be circumvented by sending requests to 
-            // $m_baseUrl.mySubdomain.wowMomImAHacker.org, but at that point, I don't care enough
-            // about implementing security checks.
-            if (0 != url.rfind(m_baseUrl, 0)) {
-                return std::nullopt; 
-            }
-            std::vector<std::pair <std::string, std::string>> dreamDownloadQuery;
-            extractQueryParams(url, dreamDownloadQuery);
-            HttpRequest req;
-            req.setMethod(HttpRequest::HttpMethod::Get);
-            req.setUrl(url);
-            req.setQueryParams(dreamDownloadQuery);
-            return req;
-        }}
-    };
-    
-    // exempt /dream_download requests to include Authorization: Bearer ...,
-    // when sending a request.
-    // this probably isn't as elegant, if I want to use this endpoint for custom requests,
-    // but it will suffice for now.
-    m_routeAuthorizationExemptions["/dream_download"] = true;
-    
-    // Builders for /friend_requests
-    m_routeRequestBuilders["/friend_requests"] = {
-        {"type", [this](const std::string& body, const auto& params) -> std::optional<HttpRequest> {
-            if ("receive" != params.at("type") && "send" != params.at("type")) {
-                return std::nullopt; 
-            }
-            HttpRequest req;
-            req.setMethod(HttpRequest::HttpMethod::Get);
-            req.setUrl(m_baseUrl + "/api/v1/friend_requests");
-            req.setQueryParams({
-                {"type", params.at("type")},
-            });
-            return req;
-        }},
-    };
-    
+bool AcbaaWebServer::acceptsRanges(std::string_view route) const {
+    return routeHasFlag(route, RouteForwardsRanges);
 }
 
-void AcbaaWebServer::prepareRequest(HttpRequest& request, const std::string& route) {
-    request.setHeader("User-Agent", m_userAgent);
-    request.setHeader("Accept", "*/*");
-    if (m_routeAuthorizationExemptions.end() == m_routeAuthorizationExemptions.find(route) ||
-       !m_routeAuthorizationExemptions.at(route)) {
-            request.setHeader("Authorization", "Bearer " + m_bearerToken);
-        }
-    request.applyMimeType();
+bool AcbaaWebServer::supportsPaging(std::string_view route) const {
+    return routeHasFlag(route, RoutePaged);
 }
 
-void AcbaaWebServer::sendBadRequest(int clientFd) {
-    const std::string msg = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
-    send(clientFd, msg.c_str(), msg.size(), 0);
+std::string AcbaaWebServer::buildStatsReport() const {
+    ResponseCache::Stats cacheStats = m_responseCache.getStats();
+    std::ostringstream report;
+    report << "response_cache.hits " << cacheStats.hits << "\n";
+    report << "response_cache.misses " << cacheStats.misses << "\n";
+    report << "response_cache.bypasses " << cacheStats.bypasses << "\n";
+    report << "response_cache.evictions " << cacheStats.evictions << "\n";
+    report << "response_cache.entries " << cacheStats.entries << "\n";
+    report << "response_cache.bytes " << cacheStats.bytes << "\n";
+    if (m_blobStore) {
+        BlobStore::Stats blobStats = m_blobStore->getStats();
+        report << "blob_store.hits " << blobStats.hits << "\n";
+        report << "blob_store.misses " << blobStats.misses << "\n";
+        report << "blob_store.stores " << blobStats.stores << "\n";
+        report << "blob_store.evictions " << blobStats.evictions << "\n";
+        report << "blob_store.entries " << blobStats.entries << "\n";
+        report << "blob_store.bytes " << blobStats.bytes << "\n";
+    }
+    return report.str();
 }
 
-void AcbaaWebServer::sendNotFound(int clientFd) {
-    const std::string msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
-    send(clientFd, msg.c_str(), msg.size(), 0);
+void AcbaaWebServer::prepareRequest(HttpRequest& request, bool authorize) const {
+    // the fixed headers are shared, not copied into every request
+    request.setBaseHeaders(authorize ? m_authorizedBaseHeaders : m_baseHeaders);
+    request.applyMimeType();
 }
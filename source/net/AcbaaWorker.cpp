@@ -0,0 +1,703 @@
+#include <net/AcbaaWorker.hpp>
+#include <net/AcbaaWebServer.hpp>
+
+#include <sys/socket.h>
+#include <sys/unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <cstring>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <optional>
+#include <cctype>
+
+namespace {
+    // Persistent connections without a request in flight are closed after this
+    constexpr auto keepAliveTimeout = std::chrono::seconds(15);
+
+    // extraHeaders are complete header lines, each ending with CRLF
+    std::string buildResponseHead(const std::string& status, const std::string& contentType, u64 contentLength, bool keepAlive, const std::string& extraHeaders = "") {
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\n";
+        response << "Content-Type: " << contentType << "\r\n";
+        response << "Content-Length: " << contentLength << "\r\n";
+        response << extraHeaders;
+        response << (keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+        response << "\r\n";
+        return response.str();
+    }
+
+    std::string buildResponse(const std::string& status, const std::string& contentType, const std::string& body, bool keepAlive) {
+        return buildResponseHead(status, contentType, body.size(), keepAlive) + body;
+    }
+
+    enum class RangeResult {
+        None,           // no usable Range header, send everything
+        Satisfiable,
+        Unsatisfiable,
+    };
+
+    // Parses a single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range.
+    // Multiple ranges aren't supported, those get the full response.
+    RangeResult parseByteRange(const std::string& range, u64 size, u64& first, u64& last) {
+        if (0 != range.rfind("bytes=", 0) || std::string::npos != range.find(',')) {
+            return RangeResult::None;
+        }
+        std::string spec = range.substr(6);
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) {
+            return RangeResult::None;
+        }
+        std::string from = spec.substr(0, dash);
+        std::string to = spec.substr(dash + 1);
+        auto isNumber = [](const std::string& s) {
+            return !s.empty() && s.size() <= 19 && std::all_of(s.begin(), s.end(), ::isdigit);
+        };
+
+        if (from.empty()) {
+            // the last n bytes
+            if (!isNumber(to)) return RangeResult::None;
+            u64 suffix = std::stoull(to);
+            if (0 == suffix || 0 == size) return RangeResult::Unsatisfiable;
+            first = (suffix < size) ? size - suffix : 0;
+            last = size - 1;
+            return RangeResult::Satisfiable;
+        }
+
+        if (!isNumber(from) || (!to.empty() && !isNumber(to))) return RangeResult::None;
+        first = std::stoull(from);
+        last = to.empty() ? size - 1 : std::min<u64>(std::stoull(to), size - 1);
+        if (!to.empty() && std::stoull(to) < first) return RangeResult::None;
+        if (first >= size) return RangeResult::Unsatisfiable;
+        return RangeResult::Satisfiable;
+    }
+
+    bool containsIgnoreCase(std::string_view haystack, std::string_view needle) {
+        auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+                              [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+        return it != haystack.end();
+    }
+
+    // HTTP/1.1 defaults to persistent connections, HTTP/1.0 has to ask for them
+    bool wantsKeepAlive(const HttpRequestParser& request) {
+        if (auto connection = request.header("Connection")) {
+            if (containsIgnoreCase(connection.value(), "close")) return false;
+            if (containsIgnoreCase(connection.value(), "keep-alive")) return true;
+        }
+        return request.isHttp11();
+    }
+
+    // Cache-Control: no-cache / Pragma: no-cache skip the response cache
+    bool wantsFreshResponse(const HttpRequestParser& request) {
+        for (const char* name : { "Cache-Control", "Pragma" }) {
+            if (auto value = request.header(name)) {
+                if (containsIgnoreCase(value.value(), "no-cache") || containsIgnoreCase(value.value(), "no-store")) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // key=value pairs separated by '&', the last one of a key wins
+    std::unordered_map<std::string, std::string> parseQueryParams(std::string_view query) {
+        std::unordered_map<std::string, std::string> params;
+        while (!query.empty()) {
+            size_t amp = query.find('&');
+            std::string_view pair = query.substr(0, amp);
+            size_t eq = pair.find('=');
+            if (eq != std::string_view::npos) {
+                params[std::string(pair.substr(0, eq))] = std::string(pair.substr(eq + 1));
+            }
+            if (amp == std::string_view::npos) break;
+            query.remove_prefix(amp + 1);
+        }
+        return params;
+    }
+}
+
+AcbaaWorker::AcbaaWorker(AcbaaWebServer& server, std::shared_ptr<SharedCurlCache> cache)
+    : HttpClient(std::move(cache)),
+      m_server(server),
+      m_running(false),
+      m_load(0) {}
+
+AcbaaWorker::~AcbaaWorker() {
+    for (auto& [fd, conn] : m_connections) {
+        closeFile(conn);
+        close(fd);
+    }
+    // running bundles cancel their transfers, the client part of this is still alive here
+    m_connections.clear();
+    while (auto fd = m_pending.pop()) {
+        close(fd.value());
+    }
+}
+
+bool AcbaaWorker::open() {
+    if (!m_wakeup.open()) return false;
+    m_running = true;
+    return true;
+}
+
+void AcbaaWorker::setPeers(const std::vector<AcbaaWorker*>& peers) {
+    m_peers.clear();
+    for (AcbaaWorker* peer : peers) {
+        if (peer != this) {
+            m_peers.push_back(peer);
+        }
+    }
+}
+
+void AcbaaWorker::stop() {
+    m_running = false;
+    m_wakeup.wake();
+}
+
+bool AcbaaWorker::isRunning() const {
+    return m_running;
+}
+
+void AcbaaWorker::assignConnection(int clientFd) {
+    m_load++;
+    m_pending.push(clientFd);
+    m_wakeup.wake();
+}
+
+size_t AcbaaWorker::getLoad() const {
+    return m_load;
+}
+
+void AcbaaWorker::adoptConnections() {
+    while (auto fd = m_pending.pop()) {
+        m_connections.emplace(fd.value(), Connection(fd.value()));
+    }
+
+    // Nothing of our own to do, help the busiest peer with its backlog
+    if (!m_connections.empty()) return;
+
+    AcbaaWorker* busiest = nullptr;
+    size_t busiestBacklog = 0;
+    for (AcbaaWorker* peer : m_peers) {
+        size_t backlog = peer->m_pending.size();
+        if (backlog > busiestBacklog) {
+            busiest = peer;
+            busiestBacklog = backlog;
+        }
+    }
+    if (!busiest) return;
+
+    if (auto fd = busiest->m_pending.steal()) {
+        busiest->m_load--;
+        m_load++;
+        m_connections.emplace(fd.value(), Connection(fd.value()));
+    }
+}
+
+bool AcbaaWorker::serverLoop(int timeoutMs) {
+    if (!m_running)
+        return false;
+
+    adoptConnections();
+
+    int idleTimeoutMs = expireIdleConnections();
+    if (idleTimeoutMs >= 0 && (timeoutMs < 0 || idleTimeoutMs < timeoutMs)) {
+        timeoutMs = idleTimeoutMs;
+    }
+
+    // One poll set for the wakeup socket, every connection reading its request or
+    // writing a local response, and the upstream sockets of all running transfers.
+    // Relaying connections are driven by their upstream transfer instead.
+    std::vector<pollfd> pfds;
+    pfds.reserve(m_connections.size() + 1);
+    pfds.push_back({ .fd = m_wakeup.fd(), .events = POLLIN, .revents = 0 });
+    for (const auto& [fd, conn] : m_connections) {
+        if (Connection::State::ReadingRequest == conn.state) {
+            pfds.push_back({ .fd = fd, .events = POLLIN, .revents = 0 });
+        }
+        else if (Connection::State::Writing == conn.state) {
+            // a bundle with nothing to send yet is waiting for its transfers,
+            // everything else is either sending or drained and about to finish
+            bool waiting = conn.outputOffset == conn.output.size() && 0 == conn.fileRemaining &&
+                           conn.bundle && !conn.bundle->isDone();
+            if (!waiting) {
+                pfds.push_back({ .fd = fd, .events = POLLOUT, .revents = 0 });
+            }
+        }
+    }
+    const size_t clientFdsEnd = pfds.size();
+    collectPollFds(pfds);
+
+    // Curl timers can shorten the wait
+    int ret = poll(pfds.data(), pfds.size(), pollTimeout(timeoutMs));
+    if (ret < 0) {
+        if (errno == EINTR) return true;
+        m_server.reportStatus("poll failed: %s", strerror(errno));
+        return false;
+    }
+    if (pfds[0].revents & POLLIN) {
+        m_wakeup.drain();
+    }
+
+    // Advance the upstream transfers first, finished ones release their connection
+    processPollFds(pfds.data() + clientFdsEnd, pfds.size() - clientFdsEnd);
+
+    for (size_t i = 1; i < clientFdsEnd; i++) {
+        if (0 == pfds[i].revents) continue;
+        if (pfds[i].events & POLLOUT) {
+            handleWritable(pfds[i].fd);
+        }
+        else {
+            handleClient(pfds[i].fd);
+        }
+    }
+
+    return true;
+}
+
+int AcbaaWorker::expireIdleConnections() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> expired;
+    int nextTimeoutMs = -1;
+    for (const auto& [fd, conn] : m_connections) {
+        if (Connection::State::ReadingRequest != conn.state) continue;
+
+        auto deadline = conn.lastActivity + keepAliveTimeout;
+        if (deadline <= now) {
+            expired.push_back(fd);
+            continue;
+        }
+        int remainingMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count()) + 1;
+        if (nextTimeoutMs < 0 || remainingMs < nextTimeoutMs) {
+            nextTimeoutMs = remainingMs;
+        }
+    }
+    for (int fd : expired) {
+        closeConnection(fd);
+    }
+    return nextTimeoutMs;
+}
+
+void AcbaaWorker::closeConnection(int clientFd) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end()) {
+        return;
+    }
+    closeFile(it->second);
+    m_connections.erase(it);
+    close(clientFd);
+    m_load--;
+    m_server.reportStatus("Closed connection (fd=%d)", clientFd);
+}
+
+void AcbaaWorker::onStreamingRequestDone(int outputFd, bool success, std::string unsent) {
+    if (!success) {
+        m_server.reportStatus("Upstream transfer failed (fd=%d)", outputFd);
+    }
+    auto it = m_connections.find(outputFd);
+    if (success && !unsent.empty() && it != m_connections.end()) {
+        // the tail of the relay goes out like a local response
+        queueResponse(it->second, std::move(unsent));
+        return;
+    }
+    finishResponse(outputFd, success);
+}
+
+void AcbaaWorker::finishResponse(int clientFd, bool success) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end()) {
+        return;
+    }
+    // A failed response leaves the framing broken, the connection can't be reused
+    if (!success || !it->second.keepAlive) {
+        closeConnection(clientFd);
+        return;
+    }
+
+    it->second.state = Connection::State::ReadingRequest;
+    it->second.lastActivity = std::chrono::steady_clock::now();
+    // answer requests that were pipelined behind this one
+    processRequests(clientFd);
+}
+
+void AcbaaWorker::queueResponse(Connection& conn, std::string response) {
+    conn.output = std::move(response);
+    conn.outputOffset = 0;
+    conn.state = Connection::State::Writing;
+    // whatever doesn't fit into the socket now is sent once poll reports it writable
+    flushOutput(conn);
+}
+
+void AcbaaWorker::queueFileResponse(Connection& conn, std::string head, int fileFd, u64 size) {
+    conn.fileFd = fileFd;
+    conn.fileRemaining = size;
+    queueResponse(conn, std::move(head));
+}
+
+void AcbaaWorker::closeFile(Connection& conn) {
+    if (conn.fileFd >= 0) {
+        close(conn.fileFd);
+        conn.fileFd = -1;
+    }
+    conn.fileRemaining = 0;
+}
+
+bool AcbaaWorker::flushOutput(Connection& conn) {
+    // one block per call, so a fast client can't hold up the other connections
+    if (conn.outputOffset == conn.output.size() && conn.fileRemaining > 0) {
+        conn.output.resize(std::min<u64>(BlobStore::ReadBlockSize, conn.fileRemaining));
+        ssize_t n = read(conn.fileFd, conn.output.data(), conn.output.size());
+        if (n <= 0) {
+            return false;
+        }
+        conn.output.resize(n);
+        conn.outputOffset = 0;
+        conn.fileRemaining -= n;
+    }
+
+    while (conn.outputOffset < conn.output.size()) {
+        ssize_t n = send(conn.fd, conn.output.data() + conn.outputOffset, conn.output.size() - conn.outputOffset, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.outputOffset += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
+
+void AcbaaWorker::handleWritable(int clientFd) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end() || Connection::State::Writing != it->second.state) {
+        return;
+    }
+    Connection& conn = it->second;
+    if (!flushOutput(conn)) {
+        closeConnection(clientFd);
+        return;
+    }
+    if (conn.outputOffset < conn.output.size() || conn.fileRemaining > 0) {
+        return;
+    }
+    conn.output.clear();
+    conn.outputOffset = 0;
+    conn.lastActivity = std::chrono::steady_clock::now();
+    if (conn.bundle && !conn.bundle->isDone()) {
+        return;
+    }
+    closeFile(conn);
+    conn.bundle.reset();
+    conn.pagedQuery.reset();
+    finishResponse(clientFd, true);
+}
+
+void AcbaaWorker::handleClient(int clientFd) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end()) {
+        return;
+    }
+    Connection& conn = it->second;
+
+    // 1) Read whatever is available without blocking the other connections
+    while (true) {
+        char buf[4096];
+        ssize_t n = recv(clientFd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            conn.buffer.append(buf, n);
+            continue;
+        }
+        if (n == 0) {
+            // requests that are already in still get their answer
+            conn.peerClosed = true;
+            break;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        if (errno == EINTR) continue;
+        closeConnection(clientFd);
+        return;
+    }
+    conn.lastActivity = std::chrono::steady_clock::now();
+
+    processRequests(clientFd);
+}
+
+void AcbaaWorker::processRequests(int clientFd) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end()) {
+        return;
+    }
+    Connection& conn = it->second;
+
+    while (Connection::State::ReadingRequest == conn.state) {
+        // 2) Wait until headers + body (Content-Length) of the next request are in,
+        // the parser picks up where the last read left it
+        HttpRequestParser& request = conn.parser;
+        HttpRequestParser::Result result = request.parse(conn.buffer);
+        if (HttpRequestParser::Result::Incomplete == result) {
+            break;
+        }
+        if (HttpRequestParser::Result::Complete != result) {
+            if (HttpRequestParser::Result::Malformed == result) {
+                sendBadRequest(clientFd);
+            }
+            else {
+                sendTooLarge(clientFd, HttpRequestParser::Result::HeadTooLarge == result);
+            }
+            closeConnection(clientFd);
+            return;
+        }
+
+        // 3) Route, body, query parameters and the headers we care about
+        std::string uri(request.path());
+        std::string postBody(request.body());
+        std::unordered_map<std::string, std::string> queryParams = parseQueryParams(request.query());
+        conn.keepAlive = !conn.peerClosed && wantsKeepAlive(request);
+        RequestHints hints;
+        hints.bypassCache = wantsFreshResponse(request) || queryParams.end() != queryParams.find("nocache");
+        hints.range = request.header("Range").value_or("");
+        hints.ifRange = request.header("If-Range").value_or("");
+
+        // whatever follows belongs to the next request
+        conn.buffer.erase(0, request.length());
+        request.reset();
+
+        // 4) Dispatch, a relay or a queued response owns the connection until it is done
+        if (handleRequest(conn, uri, postBody, queryParams, hints)) {
+            return;
+        }
+        if (!conn.keepAlive) {
+            closeConnection(clientFd);
+            return;
+        }
+    }
+
+    if (conn.peerClosed && Connection::State::ReadingRequest == conn.state) {
+        closeConnection(clientFd);
+    }
+}
+
+bool AcbaaWorker::handleRequest(
+    Connection& conn,
+    const std::string& route,
+    const std::string& body,
+    const std::unordered_map<std::string, std::string>& queryParams,
+    const RequestHints& hints) {
+    // answered by the server itself
+    if ("/stats" == route) {
+        queueResponse(conn, buildResponse("200 OK", "text/plain", m_server.buildStatsReport(), conn.keepAlive));
+        return true;
+    }
+
+    if ("/dream_bundle" == route) {
+        return startBundle(conn, body, queryParams);
+    }
+
+    HttpRequest request;
+    switch (m_server.buildRequest(route, body, queryParams, request)) {
+        case AcbaaWebServer::RouteResult::NotFound:
+            sendNotFound(conn.fd);
+            return false;
+        case AcbaaWebServer::RouteResult::BadRequest:
+            sendBadRequest(conn.fd);
+            return false;
+        case AcbaaWebServer::RouteResult::Ok:
+            break;
+    }
+
+    if (m_server.supportsPaging(route)) {
+        size_t maxResults = 0;
+        size_t pageSize = PagedQuery::pageSizeOf(request);
+        size_t pages = (pageSize > 0) ? PagedQuery::requestedPages(queryParams, pageSize, maxResults) : 0;
+        if (pages > 0) {
+            return startPagedQuery(conn, route, request, pages, maxResults, hints);
+        }
+    }
+
+    std::unique_ptr<Sink> tee;
+    std::chrono::seconds ttl = m_server.getCacheTtl(route);
+    if (ttl.count() > 0 && HttpRequest::HttpMethod::Get == request.getMethod()) {
+        ResponseCache& cache = m_server.getResponseCache();
+        std::string key = ResponseCache::makeKey(request);
+        if (hints.bypassCache) {
+            cache.countBypass();
+        }
+        else if (auto entry = cache.get(key)) {
+            queueResponse(conn, buildResponse("200 OK", entry->contentType, entry->body, conn.keepAlive));
+            return true;
+        }
+        // refill the cache while relaying
+        tee = cache.createFillSink(key, ttl);
+    }
+
+    BlobStore* blobs = m_server.getBlobStore();
+    if (blobs && m_server.usesBlobStore(route) && HttpRequest::HttpMethod::Get == request.getMethod()) {
+        std::string key = BlobStore::makeKey(request.getUrl());
+        if (auto blob = hints.bypassCache ? std::nullopt : blobs->find(key)) {
+            if (serveBlob(conn, blob.value(), hints)) {
+                return true;
+            }
+            // evicted in the meantime, fetch it again
+        }
+        tee = blobs->createFillSink(key);
+    }
+
+    if (m_server.acceptsRanges(route) && !hints.range.empty()) {
+        // partial responses are relayed as they are, the blob store only keeps complete ones
+        request.setHeader("Range", hints.range);
+        if (!hints.ifRange.empty()) {
+            request.setHeader("If-Range", hints.ifRange);
+        }
+    }
+
+    if (!startStreamingRequest(request, conn.fd, conn.keepAlive, std::move(tee))) {
+        sendBadRequest(conn.fd);
+        return false;
+    }
+    conn.state = Connection::State::Relaying;
+    return true;
+}
+
+bool AcbaaWorker::startBundle(Connection& conn, const std::string& body, const std::unordered_map<std::string, std::string>& queryParams) {
+    // IDs come in the POST body, a single one may also be passed as ?id=
+    auto idParam = queryParams.find("id");
+    std::vector<std::string> ids = DreamBundle::parseDreamIds(body + " " + (idParam != queryParams.end() ? idParam->second : ""));
+    if (ids.empty() || ids.size() > DreamBundle::MaxDreams) {
+        sendBadRequest(conn.fd);
+        return false;
+    }
+
+    std::ostringstream head;
+    head << "HTTP/1.1 200 OK\r\n";
+    head << "Content-Type: application/x-dream-bundle\r\n";
+    head << "Transfer-Encoding: chunked\r\n";
+    head << (conn.keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    head << "\r\n";
+    queueResponse(conn, head.str());
+
+    int clientFd = conn.fd;
+    conn.bundle = std::make_unique<DreamBundle>(m_server, *this, std::move(ids),
+        [this, clientFd](const char* data, size_t size) { appendChunk(clientFd, data, size); },
+        [this, clientFd]() { appendChunk(clientFd, nullptr, 0); });
+    // may already complete from the caches
+    conn.bundle->start();
+    return true;
+}
+
+bool AcbaaWorker::startPagedQuery(Connection& conn, const std::string& route, const HttpRequest& request, size_t pages, size_t maxResults, const RequestHints& hints) {
+    // merged results are cached as a whole, per page count and limit
+    std::chrono::seconds ttl = m_server.getCacheTtl(route);
+    std::string key = ResponseCache::makeKey(request) + " pages=" + std::to_string(pages) + " max_results=" + std::to_string(maxResults);
+    if (ttl.count() > 0) {
+        ResponseCache& cache = m_server.getResponseCache();
+        if (hints.bypassCache) {
+            cache.countBypass();
+        }
+        else if (auto entry = cache.get(key)) {
+            queueResponse(conn, buildResponse("200 OK", entry->contentType, entry->body, conn.keepAlive));
+            return true;
+        }
+    }
+
+    int clientFd = conn.fd;
+    conn.pagedQuery = std::make_unique<PagedQuery>(*this, request, pages, maxResults,
+        [this, clientFd, key, ttl](bool success, const std::string& contentType, std::string body) {
+            auto it = m_connections.find(clientFd);
+            if (it == m_connections.end()) {
+                return;
+            }
+            Connection& c = it->second;
+            if (!success) {
+                m_server.reportStatus("Paged query failed (fd=%d)", clientFd);
+                queueResponse(c, buildResponse("502 Bad Gateway", "text/plain", "", c.keepAlive));
+                return;
+            }
+            if (ttl.count() > 0) {
+                m_server.getResponseCache().put(key, contentType, body, ttl);
+            }
+            queueResponse(c, buildResponse("200 OK", contentType, body, c.keepAlive));
+        });
+    // the pages own the connection until the merged response is queued
+    conn.state = Connection::State::Relaying;
+    conn.pagedQuery->start();
+    return true;
+}
+
+void AcbaaWorker::appendChunk(int clientFd, const char* data, size_t size) {
+    auto it = m_connections.find(clientFd);
+    if (it == m_connections.end()) {
+        return;
+    }
+    Connection& conn = it->second;
+    // drop what was sent already before the buffer grows
+    if (conn.outputOffset > 0 && conn.outputOffset == conn.output.size()) {
+        conn.output.clear();
+        conn.outputOffset = 0;
+    }
+    // size 0 is the last chunk
+    char sizeLine[20];
+    int len = snprintf(sizeLine, sizeof(sizeLine), "%zx\r\n", size);
+    conn.output.append(sizeLine, len);
+    if (size > 0) {
+        conn.output.append(data, size);
+    }
+    conn.output.append("\r\n");
+}
+
+bool AcbaaWorker::serveBlob(Connection& conn, const BlobStore::Blob& blob, const RequestHints& hints) {
+    int fileFd = ::open(blob.path.c_str(), O_RDONLY);
+    if (fileFd < 0) {
+        return false;
+    }
+
+    // the content hash is a strong validator, resuming clients can send it back in If-Range
+    std::string etag = "\"" + blob.hash + "\"";
+    std::string headers = "ETag: " + etag + "\r\nAccept-Ranges: bytes\r\n";
+
+    u64 first = 0, last = 0;
+    RangeResult range = RangeResult::None;
+    if (hints.ifRange.empty() || hints.ifRange == etag) {
+        range = parseByteRange(hints.range, blob.size, first, last);
+    }
+
+    switch (range) {
+        case RangeResult::None:
+            queueFileResponse(conn, buildResponseHead("200 OK", blob.contentType, blob.size, conn.keepAlive, headers), fileFd, blob.size);
+            break;
+        case RangeResult::Satisfiable:
+            if (static_cast<off_t>(first) != lseek(fileFd, first, SEEK_SET)) {
+                close(fileFd);
+                return false;
+            }
+            headers += "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(blob.size) + "\r\n";
+            queueFileResponse(conn, buildResponseHead("206 Partial Content", blob.contentType, last - first + 1, conn.keepAlive, headers), fileFd, last - first + 1);
+            break;
+        case RangeResult::Unsatisfiable:
+            close(fileFd);
+            headers += "Content-Range: bytes */" + std::to_string(blob.size) + "\r\n";
+            queueResponse(conn, buildResponseHead("416 Range Not Satisfiable", blob.contentType, 0, conn.keepAlive, headers));
+            break;
+    }
+    return true;
+}
+
+void AcbaaWorker::sendBadRequest(int clientFd) {
+    const std::string msg = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+    send(clientFd, msg.c_str(), msg.size(), 0);
+}
+
+void AcbaaWorker::sendTooLarge(int clientFd, bool head) {
+    const std::string msg = head
+        ? "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+        : "HTTP/1.1 413 Content Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    send(clientFd, msg.c_str(), msg.size(), 0);
+}
+
+void AcbaaWorker::sendNotFound(int clientFd) {
+    const std::string msg = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    send(clientFd, msg.c_str(), msg.size(), 0);
+}
@@ -0,0 +1,298 @@
+#include <net/BlobStore.hpp>
+
+#include <switch.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    // Creates every missing directory of path, like mkdir -p
+    bool makeDirectories(const std::string& path) {
+        for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+            std::string prefix = path.substr(0, pos);
+            // fails for existing directories and the device root, the final check covers it
+            mkdir(prefix.c_str(), 0777);
+            if (pos == std::string::npos) break;
+        }
+        struct stat st;
+        return 0 == stat(path.c_str(), &st) && S_ISDIR(st.st_mode);
+    }
+
+    std::string toHex(const u8* data, size_t size) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(size * 2);
+        for (size_t i = 0; i < size; i++) {
+            hex.push_back(digits[data[i] >> 4]);
+            hex.push_back(digits[data[i] & 0xF]);
+        }
+        return hex;
+    }
+}
+
+// Writes a relayed response to a temporary file while hashing it
+class BlobStore::FillSink : public HttpClient::ResponseHeadSink {
+public:
+    FillSink(BlobStore& store, std::string key, std::string tempPath)
+        : m_store(store), m_key(std::move(key)), m_tempPath(std::move(tempPath)),
+          m_file(nullptr), m_size(0) {
+        sha256ContextCreate(&m_sha);
+    }
+
+    ~FillSink() override {
+        // dropped before completion
+        discard();
+    }
+
+    bool onData(const char* data, size_t size) override {
+        if (200 != m_status || m_size + size > m_store.m_maxBytes) {
+            discard();
+            return false;
+        }
+        if (!m_file) {
+            m_file = fopen(m_tempPath.c_str(), "wb");
+            if (!m_file) {
+                return false;
+            }
+            // the card is a lot faster with large writes
+            setvbuf(m_file, nullptr, _IOFBF, 64 * 1024);
+        }
+        if (size != fwrite(data, 1, size, m_file)) {
+            discard();
+            return false;
+        }
+        sha256ContextUpdate(&m_sha, data, size);
+        m_size += size;
+        return true;
+    }
+
+    void onComplete(bool success, long responseCode) override {
+        if (!success || 200 != m_status || !m_file) {
+            discard();
+            return;
+        }
+        bool written = 0 == fclose(m_file);
+        m_file = nullptr;
+        if (!written) {
+            remove(m_tempPath.c_str());
+            return;
+        }
+
+        u8 hash[SHA256_HASH_SIZE];
+        sha256ContextGetHash(&m_sha, hash);
+        m_store.add(m_key, m_tempPath, toHex(hash, sizeof(hash)), m_size, m_contentType);
+    }
+
+private:
+    void discard() {
+        if (m_file) {
+            fclose(m_file);
+            m_file = nullptr;
+            remove(m_tempPath.c_str());
+        }
+    }
+
+    BlobStore& m_store;
+    std::string m_key;
+    std::string m_tempPath;
+    FILE* m_file;
+    u64 m_size;
+    Sha256Context m_sha;
+};
+
+BlobStore::BlobStore(std::string directory, u64 maxBytes)
+    : m_directory(std::move(directory)),
+      m_maxBytes(maxBytes),
+      m_nextTemp(0) {}
+
+bool BlobStore::open() {
+    if (!makeDirectories(m_directory)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+    m_files.clear();
+    m_stats = Stats();
+
+    // one "hash \t content type \t key" line per entry, most recently used first
+    std::ifstream index(indexPath());
+    std::string line;
+    while (std::getline(index, line)) {
+        size_t tab1 = line.find('\t');
+        size_t tab2 = (tab1 != std::string::npos) ? line.find('\t', tab1 + 1) : std::string::npos;
+        if (tab2 == std::string::npos) continue;
+        std::string key = line.substr(tab2 + 1);
+        if (key.empty() || m_index.count(key)) continue;
+
+        Entry entry{ line.substr(0, tab1), line.substr(tab1 + 1, tab2 - tab1 - 1) };
+        auto file = m_files.find(entry.hash);
+        if (file == m_files.end()) {
+            struct stat st;
+            if (0 != stat(blobPath(entry.hash).c_str(), &st)) continue;
+            file = m_files.emplace(entry.hash, File{ static_cast<u64>(st.st_size), 0 }).first;
+            m_stats.bytes += file->second.size;
+        }
+        file->second.refs++;
+        m_lru.emplace_back(std::move(key), std::move(entry));
+        m_index[m_lru.back().first] = std::prev(m_lru.end());
+    }
+    index.close();
+
+    // leftovers of interrupted downloads and blobs whose removal failed earlier
+    std::vector<std::string> orphans;
+    if (DIR* dir = opendir(m_directory.c_str())) {
+        while (struct dirent* ent = readdir(dir)) {
+            std::string name = ent->d_name;
+            if ("." == name || ".." == name || "index" == name) continue;
+            if (!m_files.count(name)) {
+                orphans.push_back(name);
+            }
+        }
+        closedir(dir);
+    }
+    for (const std::string& name : orphans) {
+        remove((m_directory + "/" + name).c_str());
+    }
+
+    // the cap may have been lowered since the last run
+    while (m_lru.size() > 1 && m_stats.bytes > m_maxBytes) {
+        evict(std::prev(m_lru.end()));
+    }
+    m_stats.entries = m_index.size();
+    saveIndex();
+    return true;
+}
+
+std::string BlobStore::makeKey(const std::string& url) {
+    size_t start = url.find("://");
+    start = (start != std::string::npos) ? url.find('/', start + 3) : 0;
+    if (start == std::string::npos) {
+        return "/";
+    }
+    size_t end = url.find_first_of("?#", start);
+    return url.substr(start, end - start);
+}
+
+std::optional<BlobStore::Blob> BlobStore::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        m_stats.misses++;
+        return std::nullopt;
+    }
+
+    // the new order is persisted with the next store, hits alone don't write to the card
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    m_stats.hits++;
+    const Entry& entry = it->second->second;
+    return Blob{ blobPath(entry.hash), entry.hash, entry.contentType, m_files.at(entry.hash).size };
+}
+
+std::unique_ptr<HttpClient::Sink> BlobStore::createFillSink(const std::string& key) {
+    return std::make_unique<FillSink>(*this, key, nextTempPath());
+}
+
+BlobStore::Stats BlobStore::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void BlobStore::add(const std::string& key, const std::string& tempPath, const std::string& hash, u64 size, const std::string& contentType) {
+    // both would break the index format
+    if (std::string::npos != key.find_first_of("\t\r\n") || std::string::npos != contentType.find_first_of("\t\r\n")) {
+        remove(tempPath.c_str());
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto file = m_files.find(hash);
+    if (file != m_files.end()) {
+        // same content is already on the card under another key
+        remove(tempPath.c_str());
+    }
+    else {
+        std::string path = blobPath(hash);
+        if (0 != rename(tempPath.c_str(), path.c_str())) {
+            // an orphan with that name may still exist
+            remove(path.c_str());
+            if (0 != rename(tempPath.c_str(), path.c_str())) {
+                remove(tempPath.c_str());
+                return;
+            }
+        }
+        file = m_files.emplace(hash, File{ size, 0 }).first;
+        m_stats.bytes += size;
+    }
+    // keep the file referenced while the old entry of this key goes away
+    file->second.refs++;
+
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        evict(it->second);
+    }
+    m_lru.emplace_front(key, Entry{ hash, contentType });
+    m_index[key] = m_lru.begin();
+
+    while (m_lru.size() > 1 && m_stats.bytes > m_maxBytes) {
+        evict(std::prev(m_lru.end()));
+        m_stats.evictions++;
+    }
+    m_stats.stores++;
+    m_stats.entries = m_index.size();
+    saveIndex();
+}
+
+void BlobStore::evict(LruList::iterator it) {
+    auto file = m_files.find(it->second.hash);
+    if (file != m_files.end() && 0 == --file->second.refs) {
+        // fails while a worker still reads it, open() cleans it up then
+        remove(blobPath(file->first).c_str());
+        m_stats.bytes -= file->second.size;
+        m_files.erase(file);
+    }
+    m_index.erase(it->first);
+    m_lru.erase(it);
+    m_stats.entries = m_index.size();
+}
+
+void BlobStore::saveIndex() {
+    std::string tempPath = indexPath() + ".part";
+    FILE* f = fopen(tempPath.c_str(), "wb");
+    if (!f) {
+        return;
+    }
+    bool ok = true;
+    for (const auto& [key, entry] : m_lru) {
+        ok = ok && fprintf(f, "%s\t%s\t%s\n", entry.hash.c_str(), entry.contentType.c_str(), key.c_str()) > 0;
+    }
+    ok = (0 == fclose(f)) && ok;
+    if (!ok) {
+        remove(tempPath.c_str());
+        return;
+    }
+    // rename doesn't replace existing files on the card
+    remove(indexPath().c_str());
+    if (0 != rename(tempPath.c_str(), indexPath().c_str())) {
+        remove(tempPath.c_str());
+    }
+}
+
+std::string BlobStore::blobPath(const std::string& hash) const {
+    return m_directory + "/" + hash;
+}
+
+std::string BlobStore::indexPath() const {
+    return m_directory + "/index";
+}
+
+std::string BlobStore::nextTempPath() {
+    return m_directory + "/" + std::to_string(m_nextTemp++) + ".part";
+}
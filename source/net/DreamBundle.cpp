@@ -0,0 +1,336 @@
+#include <net/DreamBundle.hpp>
+#include <net/AcbaaWebServer.hpp>
+#include <helpers/Msgpack.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cctype>
+
+namespace {
+    // Query results are small, anything bigger isn't what we asked for
+    constexpr size_t maxQueryBytes = 1024 * 1024;
+
+    void appendLittleEndian(std::string& out, u32 value) {
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+        }
+    }
+
+    // First dream of a query result: meta URL and URL of the first content
+    bool parseFirstDream(const std::string& query, std::string& metaUrl, std::string& bodyUrl) {
+        MsgpackReader reader(query.data(), query.size());
+        u32 dreamCount = 0;
+        if (!reader.findKey("dreams") || !reader.readArrayHeader(dreamCount) || 0 == dreamCount) {
+            return false;
+        }
+
+        u32 fieldCount = 0;
+        if (!reader.readMapHeader(fieldCount)) return false;
+        for (u32 i = 0; i < fieldCount; i++) {
+            std::string name;
+            if (!reader.readString(name)) return false;
+            if ("meta" == name) {
+                if (!reader.readString(metaUrl)) return false;
+            }
+            else if ("contents" == name) {
+                MsgpackReader contents = reader;
+                u32 contentCount = 0;
+                if (contents.readArrayHeader(contentCount) && contentCount > 0 && contents.findKey("url")) {
+                    contents.readString(bodyUrl);
+                }
+                if (!reader.skip()) return false;
+            }
+            else if (!reader.skip()) {
+                return false;
+            }
+        }
+        return !metaUrl.empty() && !bodyUrl.empty();
+    }
+}
+
+// Collects a query result
+class DreamBundle::QuerySink : public HttpClient::ResponseHeadSink {
+public:
+    QuerySink(DreamBundle& bundle, size_t dream, std::string cacheKey)
+        : m_bundle(bundle), m_dream(dream), m_cacheKey(std::move(cacheKey)) {}
+
+    bool onData(const char* data, size_t size) override {
+        if (m_body.size() + size > maxQueryBytes) return false;
+        m_body.append(data, size);
+        return true;
+    }
+
+    void onComplete(bool success, long responseCode) override {
+        bool ok = success && 200 == m_status;
+        if (ok) {
+            // a later /dream_query for the same dream is answered from memory
+            std::chrono::seconds ttl = m_bundle.m_server.getCacheTtl("/dream_query");
+            if (ttl.count() > 0) {
+                m_bundle.m_server.getResponseCache().put(m_cacheKey, m_contentType, m_body, ttl);
+            }
+        }
+        m_bundle.onQueryDone(m_dream, ok, std::move(m_body));
+    }
+
+private:
+    DreamBundle& m_bundle;
+    size_t m_dream;
+    std::string m_cacheKey;
+    std::string m_body;
+};
+
+// Turns a download into frames of its entry, optionally teeing it into the blob store
+class DreamBundle::EntrySink : public HttpClient::ResponseHeadSink {
+public:
+    EntrySink(DreamBundle& bundle, u32 entry, std::unique_ptr<HttpClient::Sink> tee)
+        : m_bundle(bundle), m_entry(entry), m_tee(std::move(tee)) {}
+
+    bool onHeader(const char* data, size_t size) override {
+        if (m_tee && !m_tee->onHeader(data, size)) {
+            m_tee.reset();
+        }
+        return ResponseHeadSink::onHeader(data, size);
+    }
+
+    bool onData(const char* data, size_t size) override {
+        if (200 != m_status) return false;
+        if (m_tee && !m_tee->onData(data, size)) {
+            m_tee.reset();
+        }
+        m_bundle.writeFrame(m_entry, FrameData, data, size);
+        return true;
+    }
+
+    void onComplete(bool success, long responseCode) override {
+        if (m_tee) {
+            m_tee->onComplete(success, responseCode);
+        }
+        m_bundle.onFetchDone(m_entry, success && 200 == m_status);
+    }
+
+private:
+    DreamBundle& m_bundle;
+    u32 m_entry;
+    std::unique_ptr<HttpClient::Sink> m_tee;
+};
+
+DreamBundle::DreamBundle(AcbaaWebServer& server, HttpClient& client, std::vector<std::string> dreamIds, WriteFunc write, DoneFunc done)
+    : m_server(server),
+      m_client(client),
+      m_write(std::move(write)),
+      m_doneCallback(std::move(done)),
+      m_pendingQueries(0),
+      m_nextFetch(0),
+      m_runningFetches(0),
+      m_closing(false),
+      m_done(false) {
+    for (std::string& id : dreamIds) {
+        Dream dream;
+        dream.id = std::move(id);
+        m_dreams.push_back(std::move(dream));
+    }
+}
+
+DreamBundle::~DreamBundle() {
+    // the sinks complete with failure from here, they must not write anymore
+    m_closing = true;
+    for (HttpClient::TransferHandle handle : m_transfers) {
+        m_client.cancel(handle);
+    }
+}
+
+std::vector<std::string> DreamBundle::parseDreamIds(const std::string& text) {
+    std::vector<std::string> ids;
+    std::string current;
+    auto flush = [&]() {
+        if (!current.empty()) {
+            // DA IDs are zero padded, the API wants the plain number
+            size_t start = current.find_first_not_of('0');
+            ids.push_back((start != std::string::npos) ? current.substr(start) : "0");
+            current.clear();
+        }
+    };
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            current.push_back(c);
+        }
+        else if (('D' == c || 'd' == c) && i + 1 < text.size() && ('A' == text[i + 1] || 'a' == text[i + 1])) {
+            // the DA- prefix
+            flush();
+            i++;
+        }
+        else if ('-' == c) {
+            // separates the digit groups of a DA ID
+        }
+        else if (std::isspace(static_cast<unsigned char>(c)) || ',' == c) {
+            flush();
+        }
+        else {
+            return {};
+        }
+    }
+    flush();
+    return ids;
+}
+
+void DreamBundle::start() {
+    m_pendingQueries = m_dreams.size();
+    for (size_t i = 0; i < m_dreams.size(); i++) {
+        HttpRequest request;
+        if (AcbaaWebServer::RouteResult::Ok != m_server.buildRequest("/dream_query", "", { { "id", m_dreams[i].id } }, request)) {
+            onQueryDone(i, false, "");
+            continue;
+        }
+
+        // clients that looked the dream up just before are answered from memory
+        ResponseCache& cache = m_server.getResponseCache();
+        std::string key = ResponseCache::makeKey(request);
+        if (auto entry = cache.get(key)) {
+            onQueryDone(i, true, entry->body);
+            continue;
+        }
+
+        HttpClient::TransferHandle handle = m_client.submit(request, std::make_unique<QuerySink>(*this, i, key));
+        if (HttpClient::InvalidTransfer == handle) {
+            onQueryDone(i, false, "");
+            continue;
+        }
+        m_transfers.push_back(handle);
+    }
+}
+
+void DreamBundle::onQueryDone(size_t dream, bool success, std::string body) {
+    if (m_closing) return;
+
+    Dream& d = m_dreams[dream];
+    d.queryOk = success;
+    d.query = std::move(body);
+    if (success) {
+        parseFirstDream(d.query, d.metaUrl, d.bodyUrl);
+    }
+
+    if (0 == --m_pendingQueries) {
+        writeIndex();
+        startFetches();
+    }
+}
+
+void DreamBundle::writeIndex() {
+    // every dream gets its query result, found ones also their meta and body
+    for (size_t i = 0; i < m_dreams.size(); i++) {
+        m_entries.push_back({ i, "query", "" });
+        if (!m_dreams[i].metaUrl.empty()) {
+            m_entries.push_back({ i, "meta", m_dreams[i].metaUrl });
+            m_entries.push_back({ i, "body", m_dreams[i].bodyUrl });
+        }
+    }
+
+    std::string index;
+    MsgpackWriter writer(index);
+    writer.writeArrayHeader(m_entries.size());
+    for (const Entry& entry : m_entries) {
+        writer.writeMapHeader(2);
+        writer.writeString("id");
+        writer.writeString(m_dreams[entry.dream].id);
+        writer.writeString("kind");
+        writer.writeString(entry.kind);
+    }
+
+    std::string head = "DRMBNDL1";
+    appendLittleEndian(head, index.size());
+    head += index;
+    m_write(head.data(), head.size());
+
+    // query results are already here
+    for (u32 i = 0; i < m_entries.size(); i++) {
+        if ("query" != m_entries[i].kind) continue;
+        const Dream& dream = m_dreams[m_entries[i].dream];
+        if (!dream.query.empty()) {
+            writeFrame(i, FrameData, dream.query.data(), dream.query.size());
+        }
+        writeFrame(i, dream.queryOk ? FrameEnd : FrameFailed, nullptr, 0);
+    }
+}
+
+void DreamBundle::startFetches() {
+    while (m_runningFetches < MaxParallelFetches && m_nextFetch < m_entries.size()) {
+        u32 entry = m_nextFetch++;
+        if ("query" == m_entries[entry].kind) continue;
+        if (startFetch(entry)) {
+            m_runningFetches++;
+        }
+    }
+    if (0 == m_runningFetches && m_nextFetch >= m_entries.size()) {
+        finish();
+    }
+}
+
+bool DreamBundle::startFetch(u32 entry) {
+    HttpRequest request;
+    if (AcbaaWebServer::RouteResult::Ok != m_server.buildRequest("/dream_download", m_entries[entry].url, {}, request)) {
+        writeFrame(entry, FrameFailed, nullptr, 0);
+        return false;
+    }
+
+    std::unique_ptr<HttpClient::Sink> tee;
+    BlobStore* blobs = m_server.getBlobStore();
+    if (blobs && m_server.usesBlobStore("/dream_download")) {
+        std::string key = BlobStore::makeKey(request.getUrl());
+        if (auto blob = blobs->find(key)) {
+            int fd = open(blob->path.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                std::string block(BlobStore::ReadBlockSize, '\0');
+                u64 remaining = blob->size;
+                ssize_t n = 0;
+                while (remaining > 0 && (n = read(fd, block.data(), block.size())) > 0) {
+                    writeFrame(entry, FrameData, block.data(), n);
+                    remaining -= std::min<u64>(remaining, n);
+                }
+                close(fd);
+                writeFrame(entry, 0 == remaining ? FrameEnd : FrameFailed, nullptr, 0);
+                return false;
+            }
+        }
+        tee = blobs->createFillSink(key);
+    }
+
+    HttpClient::TransferHandle handle = m_client.submit(request, std::make_unique<EntrySink>(*this, entry, std::move(tee)));
+    if (HttpClient::InvalidTransfer == handle) {
+        writeFrame(entry, FrameFailed, nullptr, 0);
+        return false;
+    }
+    m_transfers.push_back(handle);
+    return true;
+}
+
+void DreamBundle::onFetchDone(u32 entry, bool success) {
+    if (m_closing) return;
+
+    writeFrame(entry, success ? FrameEnd : FrameFailed, nullptr, 0);
+    m_runningFetches--;
+    startFetches();
+}
+
+void DreamBundle::writeFrame(u32 entry, u32 flags, const char* data, size_t size) {
+    std::string frame;
+    frame.reserve(12 + size);
+    appendLittleEndian(frame, entry);
+    appendLittleEndian(frame, flags);
+    appendLittleEndian(frame, size);
+    if (size > 0) {
+        frame.append(data, size);
+    }
+    m_write(frame.data(), frame.size());
+}
+
+void DreamBundle::finish() {
+    if (m_done) return;
+    writeFrame(ArchiveEnd, FrameEnd, nullptr, 0);
+    m_done = true;
+    m_transfers.clear();
+    if (m_doneCallback) {
+        m_doneCallback();
+    }
+}
@@ -2,61 +2,173 @@
 
 #include <sstream>
 #include <algorithm>
+#include <vector>
+#include <functional>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 namespace {
+    // Small curl writes are collected up to this size and sent as one chunk
+    constexpr size_t relayCoalesceBytes = 32 * 1024;
+
     struct StreamContext {
         int fd;
         bool headerSent;
         bool chunked;
+        int status;
+        bool hasContentLength;
         size_t contentLength;
         std::string contentType;
+        std::string contentRange;  // of a partial upstream response
+        std::string acceptRanges;
         bool connectionClosed; // Track connection state
+        bool keepAlive;        // whether the client connection stays open after this response
+        std::string head;      // response head, goes out with the first frame
+        std::string pending;   // body data not sent yet
+        std::string backlog;   // framed output the socket didn't take yet
+        size_t backlogOffset;
+        HttpClient::Stats* stats;
         
-        StreamContext(int socket_fd) 
+        StreamContext(int socket_fd, bool keep_alive = true, HttpClient::Stats* client_stats = nullptr) 
             : fd(socket_fd), headerSent(false), chunked(false), 
-            contentLength(0), contentType("application/octet-stream"),
-            connectionClosed(false) {}
+            status(0), hasContentLength(false), contentLength(0), contentType("application/octet-stream"),
+            connectionClosed(false), keepAlive(keep_alive), backlogOffset(0), stats(client_stats) {}
     };
 
-    bool sendAll(int fd, const char* data, size_t len) {
-        size_t sent = 0;
-        int retryCount = 0;
-        const int maxRetries = 100; // Prevent infinite loops
-        
-        while (sent < len && retryCount < maxRetries) {
-            ssize_t result = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
-            
-            if (result == -1) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    // Socket buffer full, use exponential backoff
-                    retryCount++;
-                    usleep(1000 * retryCount); // 1ms, 2ms, 3ms, etc.
-                    continue;
-                } else if (errno == EPIPE || errno == ECONNRESET) {
-                    // Connection broken
-                    return false;
-                } else if (errno == EINTR) {
-                    // Interrupted system call, retry immediately
-                    continue;
-                } else {
-                    // Other serious error
-                    return false;
-                }
+    // Case-insensitive "Name: value" match, value is trimmed
+    bool matchHeader(const std::string& line, const char* lowerName, std::string& value) {
+        size_t nameLen = strlen(lowerName);
+        if (line.size() <= nameLen || ':' != line[nameLen]) return false;
+        for (size_t i = 0; i < nameLen; i++) {
+            if (std::tolower(static_cast<unsigned char>(line[i])) != lowerName[i]) return false;
+        }
+        size_t start = line.find_first_not_of(" \t", nameLen + 1);
+        size_t end = line.find_last_not_of(" \t");
+        value = (start != std::string::npos) ? line.substr(start, end - start + 1) : "";
+        return true;
+    }
+
+    enum class SendResult { Done, Blocked, Failed };
+
+    // Sends as much of iov as the socket takes without blocking.
+    // iov is consumed, what is left in it afterwards wasn't sent.
+    SendResult sendv(int fd, struct iovec* iov, int iovcnt, HttpClient::Stats* stats) {
+        while (iovcnt > 0) {
+            if (0 == iov->iov_len) {
+                iov++;
+                iovcnt--;
+                continue;
+            }
+
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            ssize_t result = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (stats) stats->relaySends++;
+
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                // Socket buffer full, the caller waits for poll instead of retrying
+                return (errno == EAGAIN || errno == EWOULDBLOCK) ? SendResult::Blocked : SendResult::Failed;
             } else if (result == 0) {
-                // Connection closed by peer
-                return false;
+                return SendResult::Failed;
+            }
+
+            if (stats) stats->relayBytes += result;
+            size_t sent = result;
+            while (iovcnt > 0 && sent >= iov->iov_len) {
+                sent -= iov->iov_len;
+                iov->iov_len = 0;
+                iov++;
+                iovcnt--;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<char*>(iov->iov_base) + sent;
+                iov->iov_len -= sent;
             }
-            
-            sent += result;
-            retryCount = 0; // Reset retry count on successful send
         }
-        
-        return sent == len;
+        return SendResult::Done;
     }
-    
+
+    // Sends what is left of the backlog
+    SendResult drainBacklog(StreamContext* context) {
+        if (context->backlogOffset == context->backlog.size()) {
+            return SendResult::Done;
+        }
+        struct iovec iov = {
+            context->backlog.data() + context->backlogOffset,
+            context->backlog.size() - context->backlogOffset
+        };
+        SendResult result = sendv(context->fd, &iov, 1, context->stats);
+        context->backlogOffset = context->backlog.size() - iov.iov_len;
+        if (SendResult::Done == result) {
+            context->backlog.clear();
+            context->backlogOffset = 0;
+        }
+        return result;
+    }
+
+    // Sends the head if it is still waiting, then pending and extra as one frame.
+    // last also ends a chunked body. What the socket doesn't take goes to the backlog.
+    bool flushStream(StreamContext* context, const char* extra, size_t extraLen, bool last) {
+        size_t payload = context->pending.size() + extraLen;
+        char chunkHeader[24];
+        int headerLen = 0;
+        if (context->chunked && payload > 0) {
+            headerLen = snprintf(chunkHeader, sizeof(chunkHeader), "%zx\r\n", payload);
+        }
+        bool chunkTrailer = context->chunked && payload > 0;
+        bool lastChunk = context->chunked && last;
+
+        struct iovec iov[6] = {
+            { const_cast<char*>(context->head.data()), context->head.size() },
+            { chunkHeader, static_cast<size_t>(headerLen) },
+            { const_cast<char*>(context->pending.data()), context->pending.size() },
+            { const_cast<char*>(extra), extraLen },
+            { const_cast<char*>("\r\n"), chunkTrailer ? 2u : 0u },
+            { const_cast<char*>("0\r\n\r\n"), lastChunk ? 5u : 0u },
+        };
+        if (context->stats && payload > 0) context->stats->relayFrames++;
+
+        // behind a backlog the frame has to wait its turn
+        SendResult result = context->backlog.empty() ? sendv(context->fd, iov, 6, context->stats) : SendResult::Blocked;
+        if (SendResult::Blocked == result) {
+            for (const struct iovec& part : iov) {
+                context->backlog.append(static_cast<const char*>(part.iov_base), part.iov_len);
+            }
+        }
+        context->head.clear();
+        context->pending.clear();
+        return SendResult::Failed != result;
+    }
+
+    // For blocking callers that have to get rid of a backlog themselves
+    bool sendBlocking(int fd, const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result > 0) {
+                sent += result;
+                continue;
+            }
+            if (result < 0 && errno == EINTR) continue;
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                pollfd pfd = { .fd = fd, .events = POLLOUT, .revents = 0 };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return false;
+        }
+        return true;
+    }
+
     std::string buildRawRequestDebugInfo(CURL* curl, const HttpRequest& request, struct curl_slist* headerList) {
         std::ostringstream rawRequest;
         
@@ -217,15 +329,147 @@ namespace {
     }
 }
 
-HttpClient::HttpClient() {
-    m_shared = curl_share_init();
-    curl_share_setopt(m_shared, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
-    curl_share_setopt(m_shared, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);  // Share connections
-    curl_share_setopt(m_shared, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);      // Share DNS cache
+struct HttpClient::Transfer {
+    TransferHandle handle;
+    std::unique_ptr<Sink> sink;
+    std::string fullUrl;
+    std::string body; // POSTFIELDS is not copied by curl, keep it alive for the transfer
+    struct curl_slist* headerList;
+    std::shared_ptr<const HttpRequest::BaseHeaders> baseHeaders; // the tail of headerList
+    int pauseFd; // paused until this socket is writable, -1 if running
+
+    Transfer(TransferHandle h, std::unique_ptr<Sink> s)
+        : handle(h), sink(std::move(s)), headerList(nullptr), pauseFd(-1) {}
+    ~Transfer() {
+        freeHeaderList(headerList, baseHeaders.get());
+    }
+};
+
+// Collects the whole response into a Reply, used by the blocking sendRequest()
+class HttpClient::ReplySink : public HttpClient::Sink {
+public:
+    ReplySink(HttpRequest::Reply& reply, bool& success)
+        : m_reply(reply), m_success(success) {}
+
+    bool onHeader(const char* data, size_t size) override {
+        return size == writeHeaderCallback(const_cast<char*>(data), 1, size, &m_reply.headers);
+    }
+    bool onData(const char* data, size_t size) override {
+        return size == writeCallback(const_cast<char*>(data), 1, size, &m_reply.body);
+    }
+    void onComplete(bool success, long responseCode) override {
+        m_reply.responseCode = static_cast<int>(responseCode);
+        m_success = success;
+    }
+private:
+    HttpRequest::Reply& m_reply;
+    bool& m_success;
+};
+
+// Relays the response as an HTTP response into a client socket,
+// optionally handing a copy of everything to a tee sink
+bool HttpClient::ResponseHeadSink::onHeader(const char* data, size_t size) {
+    std::string line(data, size);
+    while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+        line.pop_back();
+    }
+
+    // every header block (redirects, 100 Continue) starts with its own status line
+    if (0 == line.rfind("HTTP/", 0)) {
+        size_t space = line.find(' ');
+        m_status = (space != std::string::npos) ? std::atoi(line.c_str() + space + 1) : 0;
+        return true;
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) return true;
+    std::string name = line.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if ("content-type" == name) {
+        size_t start = line.find_first_not_of(" \t", colon + 1);
+        m_contentType = (start != std::string::npos) ? line.substr(start) : "";
+    }
+    return true;
+}
+
+class HttpClient::StreamSink : public HttpClient::Sink {
+public:
+    StreamSink(int outputFd, bool keepAlive, Stats* stats, std::unique_ptr<Sink> tee, std::function<void(bool, std::string)> done)
+        : m_context(outputFd, keepAlive, stats), m_tee(std::move(tee)), m_done(std::move(done)) {}
+
+    bool onHeader(const char* data, size_t size) override {
+        // a tee that gives up must not break the relay
+        if (m_tee && !m_tee->onHeader(data, size)) {
+            m_tee.reset();
+        }
+        return size == writeHeaderCallbackStream(const_cast<char*>(data), 1, size, &m_context);
+    }
+    bool onData(const char* data, size_t size) override {
+        // a client that doesn't keep up pauses the upstream transfer,
+        // curl hands the same data in again once the socket is writable
+        SendResult drained = drainBacklog(&m_context);
+        if (SendResult::Failed == drained) return false;
+        if (SendResult::Blocked == drained) {
+            pauseUntilWritable(m_context.fd);
+            return true;
+        }
+
+        if (m_tee && !m_tee->onData(data, size)) {
+            m_tee.reset();
+        }
+        return size == writeCallbackStream(const_cast<char*>(data), 1, size, &m_context);
+    }
+    void onComplete(bool success, long responseCode) override {
+        if (success && m_context.headerSent) {
+            // whatever is still buffered, plus the final chunk
+            success = flushStream(&m_context, nullptr, 0, true);
+        }
+        std::string unsent;
+        if (success) {
+            unsent = m_context.backlog.substr(m_context.backlogOffset);
+        }
+        if (m_tee) {
+            m_tee->onComplete(success, responseCode);
+        }
+        if (m_done) {
+            m_done(success, std::move(unsent));
+        }
+    }
+private:
+    StreamContext m_context;
+    std::unique_ptr<Sink> m_tee;
+    std::function<void(bool, std::string)> m_done;
+};
+
+HttpClient::HttpClient(std::shared_ptr<SharedCurlCache> cache)
+    : m_cache(cache ? std::move(cache) : std::make_shared<SharedCurlCache>()),
+      m_nextHandle(InvalidTransfer + 1) {
+    // Connections are kept per multi handle, SSL sessions and DNS come from the shared cache
+    // Let curl tell us which sockets to poll instead of polling them itself,
+    // so they can live in the same poll set as the server sockets
+    m_multi = curl_multi_init();
+    curl_multi_setopt(m_multi, CURLMOPT_SOCKETFUNCTION, HttpClient::socketCallback);
+    curl_multi_setopt(m_multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(m_multi, CURLMOPT_TIMERFUNCTION, HttpClient::timerCallback);
+    curl_multi_setopt(m_multi, CURLMOPT_TIMERDATA, this);
 }
 
 HttpClient::~HttpClient() {
-    curl_share_cleanup(m_shared);
+    for (auto& [curl, transfer] : m_transfers) {
+        curl_multi_remove_handle(m_multi, curl);
+        curl_easy_cleanup(curl);
+    }
+    m_transfers.clear();
+    m_handles.clear();
+    for (CURL* curl : m_idleHandles) {
+        curl_easy_cleanup(curl);
+    }
+    m_idleHandles.clear();
+    curl_multi_cleanup(m_multi);
+}
+
+HttpClient::Stats HttpClient::getStats() const {
+    return m_stats;
 }
 
 HttpRequest HttpClient::createRequest(const std::string& url) {
@@ -234,14 +478,38 @@ HttpRequest HttpClient::createRequest(const std::string& url) {
     return req;
 }
 
-bool HttpClient::sendRequest(const HttpRequest& request, HttpRequest::Reply& reply, bool debug) {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
-    
-    reply.responseCode = 0;
+struct curl_slist* HttpClient::buildHeaderList(const HttpRequest& request) {
+    const auto& base = request.getBaseHeaders();
+    struct curl_slist* baseList = base ? base->list() : nullptr;
+
+    struct curl_slist* head = nullptr;
+    struct curl_slist* tail = nullptr;
+    for (const auto& [key, value] : request.getHeaders()) {
+        std::string h = key + ": " + value;
+        struct curl_slist* node = curl_slist_append(nullptr, h.c_str());
+        if (!node) continue;
+        (tail ? tail->next : head) = node;
+        tail = node;
+    }
+    // curl only walks the list, the base part is linked in instead of copied
+    if (!tail) return baseList;
+    tail->next = baseList;
+    return head;
+}
+
+void HttpClient::freeHeaderList(struct curl_slist* headerList, const HttpRequest::BaseHeaders* base) {
+    struct curl_slist* baseList = base ? base->list() : nullptr;
+    while (headerList && headerList != baseList) {
+        struct curl_slist* next = headerList->next;
+        headerList->next = nullptr;
+        curl_slist_free_all(headerList);
+        headerList = next;
+    }
+}
 
-    // Enable connection sharing and keep-alive
-    curl_easy_setopt(curl, CURLOPT_SHARE, m_shared);
+void HttpClient::applyBaseOptions(CURL* curl) {
+    // Enable SSL session / DNS sharing and keep-alive
+    curl_easy_setopt(curl, CURLOPT_SHARE, m_cache->handle());
     
     // HTTP keep-alive settings
     curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
@@ -254,15 +522,50 @@ bool HttpClient::sendRequest(const HttpRequest& request, HttpRequest::Reply& rep
     curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 0L);
     curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 0L);
     curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, 10L);
-    
-    std::string fullUrl = request.buildUrlWithParams();
-    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
 
-    struct curl_slist* headerList = nullptr;
-    for (const auto& [key, value] : request.getHeaders()) {
-        std::string h = key + ": " + value;
-        headerList = curl_slist_append(headerList, h.c_str());
+    // CA bundle from memory instead of reading the file for every new connection
+    const std::string& caBundle = m_cache->caBundle();
+    if (!caBundle.empty()) {
+        struct curl_blob blob;
+        blob.data = const_cast<char*>(caBundle.data());
+        blob.len = caBundle.size();
+        blob.flags = CURL_BLOB_NOCOPY; // the cache outlives all of our handles
+        curl_easy_setopt(curl, CURLOPT_CAINFO_BLOB, &blob);
     }
+}
+
+CURL* HttpClient::acquireEasyHandle() {
+    if (!m_idleHandles.empty()) {
+        CURL* curl = m_idleHandles.back();
+        m_idleHandles.pop_back();
+        m_stats.handlesReused++;
+        return curl;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (curl) {
+        applyBaseOptions(curl);
+    }
+    return curl;
+}
+
+void HttpClient::releaseEasyHandle(CURL* curl) {
+    if (m_idleHandles.size() >= maxIdleHandles) {
+        curl_easy_cleanup(curl);
+        return;
+    }
+    // Drops all per-request options, the base options are put back right away
+    curl_easy_reset(curl);
+    applyBaseOptions(curl);
+    m_idleHandles.push_back(curl);
+}
+
+CURL* HttpClient::createEasyHandle(const HttpRequest& request, const std::string& fullUrl, struct curl_slist* headerList) {
+    auto setupStart = std::chrono::steady_clock::now();
+    CURL* curl = acquireEasyHandle();
+    if (!curl) return nullptr;
+
+    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
 
     if (request.getMethod() == HttpRequest::HttpMethod::Post || request.getMethod() == HttpRequest::HttpMethod::Put) {
@@ -275,98 +578,273 @@ bool HttpClient::sendRequest(const HttpRequest& request, HttpRequest::Reply& rep
         curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
     }
 
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HttpClient::writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &reply.body);
+    m_stats.setupCount++;
+    m_stats.setupTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - setupStart).count();
+    return curl;
+}
 
-    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HttpClient::writeHeaderCallback);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &reply.headers);
-    
-    CURLcode res = CURL_LAST;
-    if (debug) {
-        curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, HttpClient::debugCallback);
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-        reply.body = buildRawRequestDebugInfo(curl, request, headerList);
+bool HttpClient::runUntilDone(TransferHandle handle) {
+    if (InvalidTransfer == handle) return false;
+    // Note: this also advances every other queued transfer
+    while (isRunning(handle)) {
+        pump(-1);
     }
-    else {
-        res = curl_easy_perform(curl);
+    return true;
+}
+
+bool HttpClient::sendRequest(const HttpRequest& request, HttpRequest::Reply& reply, bool debug) {
+    reply.responseCode = 0;
+
+    if (debug) {
+        // Only dump what would be sent, without performing the request
+        std::string fullUrl = request.buildUrlWithParams();
+        struct curl_slist* headerList = buildHeaderList(request);
+        CURL* curl = createEasyHandle(request, fullUrl, headerList);
+        if (curl) {
+            curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, HttpClient::debugCallback);
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+            reply.body = buildRawRequestDebugInfo(curl, request, headerList);
+            releaseEasyHandle(curl);
+        }
+        freeHeaderList(headerList, request.getBaseHeaders().get());
+        return false;
     }
-    
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &reply.responseCode);
-    
-    curl_slist_free_all(headerList);
-    curl_easy_cleanup(curl);
 
-    return (res == CURLE_OK);
+    bool success = false;
+    return runUntilDone(submit(request, std::make_unique<ReplySink>(reply, success))) && success;
 }
 
 bool HttpClient::sendStreamingRequest(const HttpRequest& request, int outputFd, bool debug) {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
+    if (debug) {
+        std::string fullUrl = request.buildUrlWithParams();
+        struct curl_slist* headerList = buildHeaderList(request);
+        CURL* curl = createEasyHandle(request, fullUrl, headerList);
+        if (curl) {
+            curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, HttpClient::debugCallback);
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+            const std::string headMessage = "HTTP/1.1 218 This is fine\r\nContent-Type: application/octet-stream\r\n";
+            std::string rawBody = buildRawRequestDebugInfo(curl, request, headerList);
+            std::stringstream msg;
+            // two CRLF are important to distinguish HTTP head from body
+            msg << headMessage << "Content-Length: " << rawBody.size() << "\r\n\r\n" << rawBody;
+            send(outputFd, msg.str().c_str(), msg.str().size(), 0);
+            releaseEasyHandle(curl);
+        }
+        freeHeaderList(headerList, request.getBaseHeaders().get());
+        return false;
+    }
 
-    // Enable connection sharing and keep-alive
-    curl_easy_setopt(curl, CURLOPT_SHARE, m_shared);
-    
-    // HTTP keep-alive settings
-    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
-    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 120L);
-    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 60L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
-    
-    // Connection reuse settings
-    curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 0L);
-    curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 0L);
-    curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, 10L);
-    
-    std::string fullUrl = request.buildUrlWithParams();
-    curl_easy_setopt(curl, CURLOPT_URL, fullUrl.c_str());
+    bool success = false;
+    auto sink = std::make_unique<StreamSink>(outputFd, false, &m_stats, nullptr, [&success, outputFd](bool ok, std::string unsent) {
+        success = ok && sendBlocking(outputFd, unsent);
+    });
+    return runUntilDone(submit(request, std::move(sink))) && success;
+}
 
-    struct curl_slist* headerList = nullptr;
-    for (const auto& [key, value] : request.getHeaders()) {
-        std::string h = key + ": " + value;
-        headerList = curl_slist_append(headerList, h.c_str());
-    }
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+bool HttpClient::startStreamingRequest(const HttpRequest& request, int outputFd, bool keepAlive, std::unique_ptr<Sink> tee) {
+    auto sink = std::make_unique<StreamSink>(outputFd, keepAlive, &m_stats, std::move(tee), [this, outputFd](bool ok, std::string unsent) {
+        onStreamingRequestDone(outputFd, ok, std::move(unsent));
+    });
+    return InvalidTransfer != submit(request, std::move(sink));
+}
+
+HttpClient::TransferHandle HttpClient::submit(const HttpRequest& request, std::unique_ptr<Sink> sink) {
+    if (!sink) return InvalidTransfer;
+
+    auto transfer = std::make_unique<Transfer>(m_nextHandle, std::move(sink));
+    transfer->fullUrl = request.buildUrlWithParams();
+    transfer->body = request.getBody();
+    transfer->headerList = buildHeaderList(request);
+    transfer->baseHeaders = request.getBaseHeaders();
+
+    CURL* curl = createEasyHandle(request, transfer->fullUrl, transfer->headerList);
+    if (!curl) return InvalidTransfer;
 
     if (request.getMethod() == HttpRequest::HttpMethod::Post || request.getMethod() == HttpRequest::HttpMethod::Put) {
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, request.getBody().c_str());
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, request.getBody().size());
-        if (request.getMethod() == HttpRequest::HttpMethod::Put) {
-            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, HttpClient::sinkWriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer.get());
+
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HttpClient::sinkHeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer.get());
+
+    if (CURLM_OK != curl_multi_add_handle(m_multi, curl)) {
+        releaseEasyHandle(curl);
+        return InvalidTransfer;
+    }
+
+    TransferHandle handle = m_nextHandle++;
+    m_handles.emplace(handle, curl);
+    m_transfers.emplace(curl, std::move(transfer));
+    return handle;
+}
+
+void HttpClient::cancel(TransferHandle handle) {
+    auto handleIt = m_handles.find(handle);
+    if (handleIt == m_handles.end()) return;
+
+    CURL* curl = handleIt->second;
+    m_handles.erase(handleIt);
+    auto it = m_transfers.find(curl);
+    std::unique_ptr<Transfer> transfer = std::move(it->second);
+    m_transfers.erase(it);
+
+    curl_multi_remove_handle(m_multi, curl);
+    releaseEasyHandle(curl);
+    transfer->sink->onComplete(false, 0);
+}
+
+bool HttpClient::isRunning(TransferHandle handle) const {
+    return m_handles.end() != m_handles.find(handle);
+}
+
+size_t HttpClient::pump(int timeoutMs) {
+    std::vector<pollfd> fds;
+    collectPollFds(fds);
+
+    int ret = poll(fds.data(), fds.size(), pollTimeout(timeoutMs));
+    if (ret < 0 && errno != EINTR) {
+        perror("poll");
+    }
+    processPollFds(fds.data(), fds.size());
+
+    return m_transfers.size();
+}
+
+void HttpClient::collectPollFds(std::vector<pollfd>& fds) const {
+    for (const auto& [s, events] : m_sockets) {
+        fds.push_back({ .fd = s, .events = events, .revents = 0 });
+    }
+    // paused transfers wait for the socket they write to
+    for (const auto& [curl, transfer] : m_transfers) {
+        if (transfer->pauseFd >= 0) {
+            fds.push_back({ .fd = transfer->pauseFd, .events = POLLOUT, .revents = 0 });
         }
-    } else if (request.getMethod() == HttpRequest::HttpMethod::Get) {
-        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
     }
-    
-    // Custom write callback
-    StreamContext context = StreamContext(outputFd);
-    
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallbackStream);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
-    
-    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, writeHeaderCallbackStream);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &context);
-    
-    CURLcode res = CURL_LAST;
-    if (debug) {
-        curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, HttpClient::debugCallback);
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
-        const std::string headMessage = "HTTP/1.1 218 This is fine\r\nContent-Type: application/octet-stream\r\n";
-        std::string rawBody = buildRawRequestDebugInfo(curl, request, headerList);
-        std::stringstream msg;
-        // two CRLF are important to distinguish HTTP head from body
-        msg << headMessage << "Content-Length: " << rawBody.size() << "\r\n\r\n" << rawBody;
-        send(outputFd, msg.str().c_str(), msg.str().size(), 0);
+}
+
+int HttpClient::pollTimeout(int maxTimeoutMs) const {
+    if (!m_timerDeadline.has_value()) {
+        return maxTimeoutMs;
     }
-    else {
-        res = curl_easy_perform(curl);
-        if (context.chunked) {
-            send(context.fd, "0\r\n\r\n", 5, 0); // Final chunk
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        m_timerDeadline.value() - std::chrono::steady_clock::now()).count();
+    int curlTimeoutMs = static_cast<int>(std::max<long long>(0, remaining));
+    if (maxTimeoutMs < 0) {
+        return curlTimeoutMs;
+    }
+    return std::min(maxTimeoutMs, curlTimeoutMs);
+}
+
+void HttpClient::processPollFds(const pollfd* fds, size_t count) {
+    int running = 0;
+    std::vector<CURL*> resumed;
+    for (size_t i = 0; i < count; i++) {
+        if (0 == fds[i].revents) continue;
+
+        if (m_sockets.end() == m_sockets.find(fds[i].fd)) {
+            // errors resume too, the sink then finds the client gone
+            for (auto& [curl, transfer] : m_transfers) {
+                if (transfer->pauseFd == fds[i].fd) {
+                    transfer->pauseFd = -1;
+                    resumed.push_back(curl);
+                }
+            }
+            continue;
         }
+
+        int mask = 0;
+        if (fds[i].revents & POLLIN) mask |= CURL_CSELECT_IN;
+        if (fds[i].revents & POLLOUT) mask |= CURL_CSELECT_OUT;
+        if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) mask |= CURL_CSELECT_ERR;
+        curl_multi_socket_action(m_multi, fds[i].fd, mask, &running);
+    }
+
+    // curl delivers the held back data from in here
+    for (CURL* curl : resumed) {
+        if (m_transfers.end() != m_transfers.find(curl)) {
+            curl_easy_pause(curl, CURLPAUSE_CONT);
+        }
+    }
+
+    if (m_timerDeadline.has_value() && std::chrono::steady_clock::now() >= m_timerDeadline.value()) {
+        m_timerDeadline.reset();
+        curl_multi_socket_action(m_multi, CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+
+    completeTransfers();
+}
+
+void HttpClient::completeTransfers() {
+    CURLMsg* msg = nullptr;
+    int queued = 0;
+    while ((msg = curl_multi_info_read(m_multi, &queued))) {
+        if (CURLMSG_DONE != msg->msg) continue;
+
+        CURL* curl = msg->easy_handle;
+        bool success = (CURLE_OK == msg->data.result);
+        long responseCode = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &responseCode);
+
+        curl_multi_remove_handle(m_multi, curl);
+        releaseEasyHandle(curl);
+
+        auto it = m_transfers.find(curl);
+        if (it == m_transfers.end()) continue;
+        std::unique_ptr<Transfer> transfer = std::move(it->second);
+        m_transfers.erase(it);
+        m_handles.erase(transfer->handle);
+
+        // the sink may submit new transfers from here
+        transfer->sink->onComplete(success, responseCode);
+    }
+}
+
+size_t HttpClient::sinkWriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* transfer = static_cast<Transfer*>(userdata);
+    size_t total = size * nmemb;
+    if (!transfer->sink->onData(ptr, total)) {
+        return 0;
+    }
+    if (transfer->sink->m_pauseFd >= 0) {
+        transfer->pauseFd = transfer->sink->m_pauseFd;
+        transfer->sink->m_pauseFd = -1;
+        return CURL_WRITEFUNC_PAUSE;
     }
-    curl_slist_free_all(headerList);
-    curl_easy_cleanup(curl);
-    return (res == CURLE_OK);
+    return total;
+}
+
+size_t HttpClient::sinkHeaderCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* transfer = static_cast<Transfer*>(userdata);
+    size_t total = size * nmemb;
+    return transfer->sink->onHeader(ptr, total) ? total : 0;
+}
+
+int HttpClient::socketCallback(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+    HttpClient* self = static_cast<HttpClient*>(userp);
+    if (CURL_POLL_REMOVE == what) {
+        self->m_sockets.erase(s);
+        return 0;
+    }
+
+    short events = 0;
+    if (what & CURL_POLL_IN) events |= POLLIN;
+    if (what & CURL_POLL_OUT) events |= POLLOUT;
+    self->m_sockets[s] = events;
+    return 0;
+}
+
+int HttpClient::timerCallback(CURLM* multi, long timeoutMs, void* userp) {
+    HttpClient* self = static_cast<HttpClient*>(userp);
+    if (timeoutMs < 0) {
+        self->m_timerDeadline.reset();
+    }
+    else {
+        self->m_timerDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    }
+    return 0;
 }
 
 size_t HttpClient::writeCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
@@ -397,39 +875,14 @@ size_t HttpClient::writeCallbackStream(char* ptr, size_t size, size_t nmemb, voi
         return total;
     }
 
-    if (context->chunked) {
-        const size_t maxChunkSize = 8192; // Larger chunks for better performance
-        size_t sent = 0;
-
-        while (sent < total) {
-            size_t chunkSize = std::min(maxChunkSize, total - sent);
-            
-            // Build chunk header
-            char chunkHeader[16];
-            int headerLen = snprintf(chunkHeader, sizeof(chunkHeader), "%x\r\n", (unsigned int)chunkSize);
-            
-            // Send chunk header
-            if (!sendAll(context->fd, chunkHeader, headerLen)) {
-                return 0; // Signal error to curl
-            }
-            
-            // Send chunk data
-            if (!sendAll(context->fd, ptr + sent, chunkSize)) {
-                return 0;
-            }
-            
-            // Send chunk trailer
-            if (!sendAll(context->fd, "\r\n", 2)) {
-                return 0;
-            }
-            
-            sent += chunkSize;
-        }
-    } else {
-        // Non-chunked transfer
-        if (!sendAll(context->fd, ptr, total)) {
-            return 0;
-        }
+    // small writes wait for more, a full buffer goes out as one chunk without copying the last write.
+    // The first write doesn't wait so the client gets the head right away.
+    if (context->head.empty() && context->pending.size() + total < relayCoalesceBytes) {
+        context->pending.append(ptr, total);
+        return total;
+    }
+    if (!flushStream(context, ptr, total, false)) {
+        return 0; // Signal error to curl
     }
 
     return total;
@@ -447,6 +900,19 @@ size_t HttpClient::writeHeaderCallbackStream(char* buffer, size_t size, size_t n
         line = line.substr(0, line.size() - 2);
     }
 
+    // Status line, every header block (e.g. after 100 Continue) starts with one
+    if (0 == line.rfind("HTTP/", 0)) {
+        size_t space = line.find(' ');
+        context->status = (space != std::string::npos) ? std::atoi(line.c_str() + space + 1) : 0;
+        context->hasContentLength = false;
+        context->contentLength = 0;
+        context->contentRange.clear();
+        context->acceptRanges.clear();
+    }
+
+    matchHeader(line, "content-range", context->contentRange);
+    matchHeader(line, "accept-ranges", context->acceptRanges);
+
     // Parse Content-Type header
     if (line.find("Content-Type:") == 0 || line.find("content-type:") == 0) {
         size_t colonPos = line.find(':');
@@ -476,6 +942,7 @@ size_t HttpClient::writeHeaderCallbackStream(char* buffer, size_t size, size_t n
             }
             try {
                 context->contentLength = std::stoul(lengthStr);
+                context->hasContentLength = true;
             } catch (const std::exception&) {
                 context->contentLength = 0;
             }
@@ -483,13 +950,28 @@ size_t HttpClient::writeHeaderCallbackStream(char* buffer, size_t size, size_t n
     }
     
     // Check for end of headers (empty line)
-    if (buffer[0] == '\r' && buffer[1] == '\n' && !context->headerSent) {
+    // Interim responses like 100 Continue are followed by the real one
+    bool interim = context->status >= 100 && context->status < 200;
+    if (buffer[0] == '\r' && buffer[1] == '\n' && !context->headerSent && !interim) {
         // Send response headers
         std::ostringstream responseHeaders;
-        responseHeaders << "HTTP/1.1 200 OK\r\n";
+        // partial responses keep their status, so resuming clients can tell them apart
+        if (206 == context->status) {
+            responseHeaders << "HTTP/1.1 206 Partial Content\r\n";
+        } else if (416 == context->status) {
+            responseHeaders << "HTTP/1.1 416 Range Not Satisfiable\r\n";
+        } else {
+            responseHeaders << "HTTP/1.1 200 OK\r\n";
+        }
         responseHeaders << "Content-Type: " << context->contentType << "\r\n";
+        if (!context->contentRange.empty()) {
+            responseHeaders << "Content-Range: " << context->contentRange << "\r\n";
+        }
+        if (!context->acceptRanges.empty()) {
+            responseHeaders << "Accept-Ranges: " << context->acceptRanges << "\r\n";
+        }
         
-        if (context->contentLength > 0) {
+        if (context->hasContentLength) {
             responseHeaders << "Content-Length: " << context->contentLength << "\r\n";
             context->chunked = false;
         } else {
@@ -498,14 +980,11 @@ size_t HttpClient::writeHeaderCallbackStream(char* buffer, size_t size, size_t n
         }
         
         // Add keep-alive headers if needed
-        responseHeaders << "Connection: keep-alive\r\n";
+        responseHeaders << (context->keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
         responseHeaders << "\r\n";
         
-        std::string headerStr = responseHeaders.str();
-        if (!sendAll(context->fd, headerStr.c_str(), headerStr.size())) {
-            return 0; // Signal error
-        }
-        
+        // sent together with the first body frame
+        context->head = responseHeaders.str();
         context->headerSent = true;
     }
     
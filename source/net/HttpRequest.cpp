@@ -2,22 +2,110 @@
 
 #include <curl/curl.h>
 
-#include <sstream>
+#include <array>
+
+namespace {
+    // RFC 3986 unreserved characters, the ones curl_easy_escape leaves alone as well
+    constexpr std::array<bool, 256> buildUnreservedTable() {
+        std::array<bool, 256> table{};
+        for (int c = 0; c < 256; c++) {
+            table[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                       '-' == c || '.' == c || '_' == c || '~' == c;
+        }
+        return table;
+    }
+    constexpr std::array<bool, 256> unreserved = buildUnreservedTable();
+    constexpr char hexDigits[] = "0123456789ABCDEF";
+
+    size_t escapedSize(std::string_view s) {
+        size_t size = s.size();
+        for (char c : s) {
+            if (!unreserved[static_cast<u8>(c)]) size += 2;
+        }
+        return size;
+    }
+
+    void appendEscaped(std::string& out, std::string_view s) {
+        size_t i = 0;
+        while (i < s.size() && unreserved[static_cast<u8>(s[i])]) i++;
+        // nothing to escape, the common case for IDs and numbers
+        out.append(s.data(), i);
+        for (; i < s.size(); i++) {
+            u8 c = static_cast<u8>(s[i]);
+            if (unreserved[c]) {
+                out.push_back(static_cast<char>(c));
+            }
+            else {
+                char escaped[3] = { '%', hexDigits[c >> 4], hexDigits[c & 0xF] };
+                out.append(escaped, 3);
+            }
+        }
+    }
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    std::string unescape(std::string_view s) {
+        std::string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); i++) {
+            if ('%' == s[i] && i + 2 < s.size() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+                out.push_back(static_cast<char>(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2])));
+                i += 2;
+            }
+            else {
+                out.push_back(s[i]);
+            }
+        }
+        return out;
+    }
+
+    // Calls visit(key, value) with the still encoded pairs of a query string until it returns false
+    template <typename Visitor>
+    void forEachEncodedPair(std::string_view query, Visitor visit) {
+        while (!query.empty()) {
+            size_t amp = query.find('&');
+            std::string_view pair = query.substr(0, amp);
+            size_t eq = pair.find('=');
+            std::string_view key = pair.substr(0, eq);
+            std::string_view value = (std::string_view::npos != eq) ? pair.substr(eq + 1) : std::string_view();
+            if (!visit(key, value)) return;
+            if (std::string_view::npos == amp) return;
+            query.remove_prefix(amp + 1);
+        }
+    }
+}
+
+HttpRequest::BaseHeaders::BaseHeaders(HeaderFields fields)
+    : m_fields(std::move(fields)), m_list(nullptr) {
+    for (const auto& [key, value] : m_fields) {
+        std::string line = key + ": " + value;
+        m_list = curl_slist_append(m_list, line.c_str());
+    }
+}
+
+HttpRequest::BaseHeaders::~BaseHeaders() {
+    curl_slist_free_all(m_list);
+}
 
 HttpRequest::HttpRequest()
     : m_mime(MimeType::None), m_method(HttpMethod::Get) {}
 
-void HttpRequest::setUrl(const std::string& u) { m_url = u; }
-std::string HttpRequest::getUrl() const { return m_url; }
+void HttpRequest::setUrl(std::string u) { m_url = std::move(u); }
+const std::string& HttpRequest::getUrl() const { return m_url; }
 
 void HttpRequest::setMethod(HttpMethod m) { m_method = m; }
 HttpRequest::HttpMethod HttpRequest::getMethod() const { return m_method; }
 
-void HttpRequest::setBody(const std::string& b) { m_body = b; }
+void HttpRequest::setBody(std::string b) { m_body = std::move(b); }
 void HttpRequest::setBody(const std::vector<uint8_t>& data) {
     m_body.assign(reinterpret_cast<const char*>(data.data()), data.size());
 }
-std::string HttpRequest::getBody() const { return m_body; }
+const std::string& HttpRequest::getBody() const { return m_body; }
 
 void HttpRequest::setMimeType(MimeType type) {
     m_mime = type;
@@ -31,62 +119,109 @@ void HttpRequest::applyMimeType() {
 
 HttpRequest::MimeType HttpRequest::getMimeType() const { return m_mime; }
 
-void HttpRequest::setHeader(HeaderFields& headers, const std::string& key, const std::string& value) {
+void HttpRequest::setHeader(HeaderFields& headers, std::string_view key, std::string value) {
     for (auto& pair : headers) {
         if (pair.first == key) {
-            pair.second = value;
+            pair.second = std::move(value);
             return;
         }
     }
-    headers.emplace_back(key, value);
+    headers.emplace_back(key, std::move(value));
 }
 
-void HttpRequest::setHeader(const std::string& key, const std::string& value) {
-    HttpRequest::setHeader(m_headers, key, value);
+void HttpRequest::setHeader(std::string_view key, std::string value) {
+    HttpRequest::setHeader(m_headers, key, std::move(value));
 }
 
-void HttpRequest::setHeaders(const HeaderFields& newHeaders) {
-    m_headers = newHeaders;
+void HttpRequest::setHeaders(HeaderFields newHeaders) {
+    m_headers = std::move(newHeaders);
 }
 
 const HttpRequest::HeaderFields& HttpRequest::getHeaders() const {
     return m_headers;
 }
 
-void HttpRequest::setQueryParam(const std::string& key, const std::string& value) {
+void HttpRequest::setBaseHeaders(std::shared_ptr<const BaseHeaders> headers) {
+    m_baseHeaders = std::move(headers);
+}
+
+const std::shared_ptr<const HttpRequest::BaseHeaders>& HttpRequest::getBaseHeaders() const {
+    return m_baseHeaders;
+}
+
+void HttpRequest::setStaticQuery(std::string_view encoded) {
+    m_staticQuery = encoded;
+}
+
+void HttpRequest::expandStaticQuery() {
+    std::vector<std::pair<std::string, std::string>> params;
+    forEachEncodedPair(m_staticQuery, [&params](std::string_view key, std::string_view value) {
+        params.emplace_back(unescape(key), unescape(value));
+        return true;
+    });
+    m_queryParams.insert(m_queryParams.begin(), params.begin(), params.end());
+    m_staticQuery = {};
+}
+
+void HttpRequest::setQueryParam(std::string_view key, std::string value) {
     for (auto& pair : m_queryParams) {
         if (pair.first == key) {
-            pair.second = value;
+            pair.second = std::move(value);
             return;
         }
     }
-    m_queryParams.emplace_back(key, value);
+    // the static ones can't be changed in place
+    if (!m_staticQuery.empty() && getQueryParam(key)) {
+        expandStaticQuery();
+        setQueryParam(key, std::move(value));
+        return;
+    }
+    m_queryParams.emplace_back(key, std::move(value));
 }
 
-void HttpRequest::setQueryParams(const std::vector<std::pair<std::string, std::string>>& params) {
-    m_queryParams = params;
+void HttpRequest::setQueryParams(std::vector<std::pair<std::string, std::string>> params) {
+    m_queryParams = std::move(params);
 }
 
 const std::vector<std::pair<std::string, std::string>>& HttpRequest::getQueryParams() const {
     return m_queryParams;
 }
 
+std::optional<std::string> HttpRequest::getQueryParam(std::string_view key) const {
+    for (const auto& [k, v] : m_queryParams) {
+        if (k == key) return v;
+    }
+    std::optional<std::string> found;
+    forEachEncodedPair(m_staticQuery, [&](std::string_view k, std::string_view v) {
+        if (unescape(k) == key) {
+            found = unescape(v);
+            return false;
+        }
+        return true;
+    });
+    return found;
+}
+
 std::string HttpRequest::buildUrlWithParams() const {
-    if (m_queryParams.empty()) return m_url;
+    if (m_staticQuery.empty() && m_queryParams.empty()) return m_url;
 
-    std::ostringstream oss;
-    oss << m_url << "?";
-    bool first = true;
+    // one allocation for the whole URL
+    size_t size = m_url.size() + 1 + m_staticQuery.size();
+    for (const auto& [k, v] : m_queryParams) {
+        size += escapedSize(k) + escapedSize(v) + 2;
+    }
+    std::string url;
+    url.reserve(size);
+    url += m_url;
+    url += '?';
+    url += m_staticQuery;
     for (const auto& [k, v] : m_queryParams) {
-        if (!first) oss << "&";
-        char* ek = curl_easy_escape(nullptr, k.c_str(), 0);
-        char* ev = curl_easy_escape(nullptr, v.c_str(), 0);
-        oss << ek << "=" << ev;
-        curl_free(ek);
-        curl_free(ev);
-        first = false;
-    }
-    return oss.str();
+        if ('?' != url.back()) url += '&';
+        appendEscaped(url, k);
+        url += '=';
+        appendEscaped(url, v);
+    }
+    return url;
 }
 
 std::string HttpRequest::mimeTypeToString(MimeType mime) {
@@ -0,0 +1,191 @@
+#include <net/HttpRequestParser.hpp>
+
+#include <cstring>
+
+namespace {
+    bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            char x = a[i], y = b[i];
+            if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+            if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+            if (x != y) return false;
+        }
+        return true;
+    }
+
+    // RFC 9110 tchar, what header names and methods are made of
+    bool isTokenChar(char c) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return true;
+        return nullptr != strchr("!#$%&'*+-.^_`|~", c) && '\0' != c;
+    }
+
+    bool isToken(std::string_view s) {
+        if (s.empty()) return false;
+        for (char c : s) {
+            if (!isTokenChar(c)) return false;
+        }
+        return true;
+    }
+}
+
+HttpRequestParser::HttpRequestParser()
+    : m_data(nullptr) {
+    reset();
+}
+
+void HttpRequestParser::reset() {
+    m_state = State::RequestLine;
+    m_lineStart = 0;
+    m_scan = 0;
+    m_method = {};
+    m_target = {};
+    m_body = {};
+    m_http11 = false;
+    m_headerCount = 0;
+}
+
+HttpRequestParser::Result HttpRequestParser::parse(const std::string& buffer) {
+    // the buffer may have moved, only offsets are kept between calls
+    m_data = buffer.data();
+    const size_t size = buffer.size();
+
+    while (State::RequestLine == m_state || State::Headers == m_state) {
+        // memchr is the vectorized search of the C library
+        const void* lf = (m_scan < size) ? memchr(m_data + m_scan, '\n', size - m_scan) : nullptr;
+        if (!lf) {
+            m_scan = size;
+            return (size > MaxHeadBytes) ? Result::HeadTooLarge : Result::Incomplete;
+        }
+        size_t lineEnd = static_cast<const char*>(lf) - m_data;
+        if (lineEnd + 1 > MaxHeadBytes) {
+            return Result::HeadTooLarge;
+        }
+        size_t start = m_lineStart;
+        size_t end = (lineEnd > start && '\r' == m_data[lineEnd - 1]) ? lineEnd - 1 : lineEnd;
+        m_lineStart = m_scan = lineEnd + 1;
+
+        if (State::RequestLine == m_state) {
+            // empty lines in front of a request are allowed
+            if (start == end) continue;
+            if (!parseRequestLine(start, end)) return Result::Malformed;
+            m_state = State::Headers;
+        }
+        else if (start == end) {
+            Result result = startBody(m_lineStart);
+            if (Result::Complete != result) return result;
+            m_state = State::Body;
+        }
+        else if (m_headerCount == MaxHeaders) {
+            return Result::HeadTooLarge;
+        }
+        else if (!parseHeader(start, end)) {
+            return Result::Malformed;
+        }
+    }
+
+    if (State::Body == m_state) {
+        if (size < m_body.offset + m_body.size) {
+            return Result::Incomplete;
+        }
+        m_state = State::Done;
+    }
+    return Result::Complete;
+}
+
+bool HttpRequestParser::parseRequestLine(size_t start, size_t end) {
+    std::string_view line(m_data + start, end - start);
+    size_t firstSpace = line.find(' ');
+    size_t lastSpace = line.rfind(' ');
+    if (std::string_view::npos == firstSpace || firstSpace == lastSpace) {
+        return false;
+    }
+
+    m_method = { start, firstSpace };
+    m_target = { start + firstSpace + 1, lastSpace - firstSpace - 1 };
+    std::string_view version = line.substr(lastSpace + 1);
+    if (!isToken(method()) || target().empty() || std::string_view::npos != target().find(' ')) {
+        return false;
+    }
+    if ("HTTP/1.1" == version) {
+        m_http11 = true;
+    }
+    else if ("HTTP/1.0" != version) {
+        return false;
+    }
+    return true;
+}
+
+bool HttpRequestParser::parseHeader(size_t start, size_t end) {
+    std::string_view line(m_data + start, end - start);
+    size_t colon = line.find(':');
+    // no whitespace before the colon, and no obsolete line folding
+    if (std::string_view::npos == colon || !isToken(line.substr(0, colon))) {
+        return false;
+    }
+
+    size_t valueStart = colon + 1;
+    size_t valueEnd = line.size();
+    while (valueStart < valueEnd && (' ' == line[valueStart] || '\t' == line[valueStart])) valueStart++;
+    while (valueEnd > valueStart && (' ' == line[valueEnd - 1] || '\t' == line[valueEnd - 1])) valueEnd--;
+
+    Header& header = m_headers[m_headerCount++];
+    header.name = { start, colon };
+    header.value = { start + valueStart, valueEnd - valueStart };
+    return true;
+}
+
+HttpRequestParser::Result HttpRequestParser::startBody(size_t headEnd) {
+    m_body = { headEnd, 0 };
+
+    // a chunked body couldn't be told apart from the next request
+    if (header("Transfer-Encoding")) {
+        return Result::Malformed;
+    }
+
+    std::optional<std::string_view> contentLength;
+    for (size_t i = 0; i < m_headerCount; i++) {
+        if (!equalsIgnoreCase(view(m_headers[i].name), "Content-Length")) continue;
+        // repeated ones have to agree, otherwise the body length is ambiguous
+        if (contentLength && contentLength.value() != view(m_headers[i].value)) {
+            return Result::Malformed;
+        }
+        contentLength = view(m_headers[i].value);
+    }
+    if (!contentLength) {
+        return Result::Complete;
+    }
+
+    std::string_view digits = contentLength.value();
+    if (digits.empty()) {
+        return Result::Malformed;
+    }
+    size_t length = 0;
+    for (char c : digits) {
+        if (c < '0' || c > '9') return Result::Malformed;
+        length = length * 10 + (c - '0');
+        if (length > MaxBodyBytes) return Result::BodyTooLarge;
+    }
+    m_body.size = length;
+    return Result::Complete;
+}
+
+std::string_view HttpRequestParser::path() const {
+    std::string_view t = target();
+    return t.substr(0, t.find('?'));
+}
+
+std::string_view HttpRequestParser::query() const {
+    std::string_view t = target();
+    size_t mark = t.find('?');
+    return (std::string_view::npos != mark) ? t.substr(mark + 1) : std::string_view();
+}
+
+std::optional<std::string_view> HttpRequestParser::header(std::string_view name) const {
+    for (size_t i = 0; i < m_headerCount; i++) {
+        if (equalsIgnoreCase(view(m_headers[i].name), name)) {
+            return view(m_headers[i].value);
+        }
+    }
+    return std::nullopt;
+}
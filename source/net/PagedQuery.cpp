@@ -0,0 +1,211 @@
+#include <net/PagedQuery.hpp>
+#include <helpers/Msgpack.hpp>
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+    // Result pages are small, anything bigger isn't what we asked for
+    constexpr size_t maxPageBytes = 4 * 1024 * 1024;
+
+    size_t parseCount(const std::string& value) {
+        if (value.empty() || value.size() > 9 || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+            return 0;
+        }
+        return std::stoul(value);
+    }
+
+    // Number of entries in the dreams array, 0 if it can't be read
+    size_t countDreams(const std::string& body) {
+        MsgpackReader reader(body.data(), body.size());
+        u32 count = 0;
+        if (!reader.findKey("dreams") || !reader.readArrayHeader(count)) {
+            return 0;
+        }
+        return count;
+    }
+}
+
+class PagedQuery::PageSink : public HttpClient::ResponseHeadSink {
+public:
+    PageSink(PagedQuery& query, size_t page)
+        : m_query(query), m_page(page) {}
+
+    bool onData(const char* data, size_t size) override {
+        if (m_body.size() + size > maxPageBytes) return false;
+        m_body.append(data, size);
+        return true;
+    }
+
+    void onComplete(bool success, long responseCode) override {
+        m_query.onPageDone(m_page, success && 200 == m_status, std::move(m_contentType), std::move(m_body));
+    }
+
+private:
+    PagedQuery& m_query;
+    size_t m_page;
+    std::string m_body;
+};
+
+PagedQuery::PagedQuery(HttpClient& client, const HttpRequest& firstPage, size_t pages, size_t maxResults, DoneFunc done)
+    : m_client(client),
+      m_firstPage(firstPage),
+      m_pageSize(pageSizeOf(firstPage)),
+      m_firstOffset(0),
+      m_maxResults(maxResults),
+      m_doneCallback(std::move(done)),
+      m_pages(std::clamp<size_t>(pages, 1, MaxPages)),
+      m_pageLimit(m_pages.size()),
+      m_nextPage(0),
+      m_running(0),
+      m_closing(false),
+      m_done(false) {
+    m_firstOffset = parseCount(firstPage.getQueryParam("offset").value_or(""));
+    // moves a static offset to the other parameters here, not once for every page
+    m_firstPage.setQueryParam("offset", std::to_string(m_firstOffset));
+}
+
+PagedQuery::~PagedQuery() {
+    // the sinks complete with failure from here, they must not call back anymore
+    m_closing = true;
+    for (HttpClient::TransferHandle handle : m_transfers) {
+        m_client.cancel(handle);
+    }
+}
+
+size_t PagedQuery::requestedPages(const std::unordered_map<std::string, std::string>& queryParams, size_t pageSize, size_t& maxResults) {
+    auto pagesIt = queryParams.find("pages");
+    auto maxIt = queryParams.find("max_results");
+    maxResults = (maxIt != queryParams.end()) ? parseCount(maxIt->second) : 0;
+    if (pagesIt == queryParams.end() && 0 == maxResults) {
+        return 0;
+    }
+
+    size_t pages = (pagesIt != queryParams.end()) ? parseCount(pagesIt->second) : MaxPages;
+    if (maxResults > 0 && pageSize > 0) {
+        pages = std::min(pages, (maxResults + pageSize - 1) / pageSize);
+    }
+    return std::clamp<size_t>(pages, 1, MaxPages);
+}
+
+size_t PagedQuery::pageSizeOf(const HttpRequest& request) {
+    return parseCount(request.getQueryParam("limit").value_or(""));
+}
+
+void PagedQuery::start() {
+    startPages();
+}
+
+void PagedQuery::startPages() {
+    while (m_running < MaxParallelPages && m_nextPage < m_pageLimit) {
+        size_t page = m_nextPage++;
+        HttpRequest request = m_firstPage;
+        request.setQueryParam("offset", std::to_string(m_firstOffset + page * m_pageSize));
+
+        HttpClient::TransferHandle handle = m_client.submit(request, std::make_unique<PageSink>(*this, page));
+        if (HttpClient::InvalidTransfer == handle) {
+            m_pages[page].done = true;
+            continue;
+        }
+        m_transfers.push_back(handle);
+        m_running++;
+    }
+
+    if (0 == m_running) {
+        // a page that failed to start fails the whole query
+        bool ok = true;
+        for (size_t i = 0; i < m_pageLimit; i++) {
+            ok = ok && m_pages[i].ok;
+        }
+        finish(ok);
+    }
+}
+
+void PagedQuery::onPageDone(size_t page, bool success, std::string contentType, std::string body) {
+    if (m_closing) return;
+
+    Page& p = m_pages[page];
+    p.done = true;
+    p.ok = success;
+    p.contentType = std::move(contentType);
+    p.body = std::move(body);
+    m_running--;
+
+    // a short page is the last one, the pages after it would come back empty
+    if (success && countDreams(p.body) < m_pageSize) {
+        m_pageLimit = std::min(m_pageLimit, page + 1);
+    }
+    startPages();
+}
+
+bool PagedQuery::merge(std::string& out) const {
+    const std::string& first = m_pages[0].body;
+    MsgpackReader reader(first.data(), first.size());
+    u32 fieldCount = 0;
+    if (!reader.readMapHeader(fieldCount)) {
+        return false;
+    }
+
+    // keys and values of the first page, as raw slices
+    struct Field { size_t start, valueStart, end; bool dreams; };
+    std::vector<Field> fields;
+    for (u32 i = 0; i < fieldCount; i++) {
+        Field field;
+        field.start = reader.offset();
+        std::string name;
+        MsgpackReader key = reader;
+        field.dreams = key.readString(name) && "dreams" == name;
+        if (!reader.skip()) return false;
+        field.valueStart = reader.offset();
+        if (!reader.skip()) return false;
+        field.end = reader.offset();
+        fields.push_back(field);
+    }
+
+    // dreams of all pages in order, each id once
+    std::vector<std::pair<const char*, size_t>> dreams;
+    std::unordered_set<s64> seen;
+    for (size_t i = 0; i < m_pageLimit; i++) {
+        const std::string& body = m_pages[i].body;
+        MsgpackReader page(body.data(), body.size());
+        u32 count = 0;
+        if (!page.findKey("dreams") || !page.readArrayHeader(count)) continue;
+        for (u32 j = 0; j < count; j++) {
+            size_t start = page.offset();
+            MsgpackReader dream = page;
+            s64 id = 0;
+            bool hasId = dream.findKey("id") && dream.readInt(id);
+            if (!page.skip()) break;
+            if (hasId && !seen.insert(id).second) continue;
+            if (m_maxResults > 0 && dreams.size() >= m_maxResults) break;
+            dreams.emplace_back(body.data() + start, page.offset() - start);
+        }
+    }
+
+    MsgpackWriter writer(out);
+    writer.writeMapHeader(fieldCount);
+    for (const Field& field : fields) {
+        if (!field.dreams) {
+            writer.writeRaw(first.data() + field.start, field.end - field.start);
+            continue;
+        }
+        writer.writeRaw(first.data() + field.start, field.valueStart - field.start);
+        writer.writeArrayHeader(dreams.size());
+        for (const auto& [data, size] : dreams) {
+            writer.writeRaw(data, size);
+        }
+    }
+    return true;
+}
+
+void PagedQuery::finish(bool success) {
+    if (m_done) return;
+    m_done = true;
+    m_transfers.clear();
+
+    std::string body;
+    success = success && merge(body);
+    if (m_doneCallback) {
+        m_doneCallback(success, success ? m_pages[0].contentType : "", std::move(body));
+    }
+}
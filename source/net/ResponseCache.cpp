@@ -0,0 +1,114 @@
+#include <net/ResponseCache.hpp>
+
+namespace {
+    size_t entrySize(const std::string& key, const ResponseCache::Entry& entry) {
+        return key.size() + entry.contentType.size() + entry.body.size();
+    }
+}
+
+// Collects the body of a relayed response
+class ResponseCache::FillSink : public HttpClient::ResponseHeadSink {
+public:
+    FillSink(ResponseCache& cache, std::string key, std::chrono::seconds ttl)
+        : m_cache(cache), m_key(std::move(key)), m_ttl(ttl) {}
+
+    bool onData(const char* data, size_t size) override {
+        if (m_body.size() + size > m_cache.m_maxEntryBytes) {
+            // too big to be worth caching, stop copying
+            return false;
+        }
+        m_body.append(data, size);
+        return true;
+    }
+
+    void onComplete(bool success, long responseCode) override {
+        if (success && 200 == m_status) {
+            m_cache.put(m_key, std::move(m_contentType), std::move(m_body), m_ttl);
+        }
+    }
+
+private:
+    ResponseCache& m_cache;
+    std::string m_key;
+    std::chrono::seconds m_ttl;
+    std::string m_body;
+};
+
+ResponseCache::ResponseCache(size_t maxBytes, size_t maxEntryBytes)
+    : m_maxBytes(maxBytes),
+      m_maxEntryBytes(maxEntryBytes) {}
+
+std::string ResponseCache::makeKey(const HttpRequest& request) {
+    return HttpRequest::httpMethodToString(request.getMethod()) + " " + request.buildUrlWithParams();
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        m_stats.misses++;
+        return nullptr;
+    }
+
+    std::shared_ptr<const Entry> entry = it->second->second;
+    if (entry->expires <= std::chrono::steady_clock::now()) {
+        evict(it->second);
+        m_stats.misses++;
+        return nullptr;
+    }
+
+    // move to the front, it's the most recently used now
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    m_stats.hits++;
+    return entry;
+}
+
+void ResponseCache::put(const std::string& key, std::string contentType, std::string body, std::chrono::seconds ttl) {
+    auto entry = std::make_shared<Entry>();
+    entry->contentType = std::move(contentType);
+    entry->body = std::move(body);
+    entry->expires = std::chrono::steady_clock::now() + ttl;
+
+    size_t size = entrySize(key, *entry);
+    if (size > m_maxEntryBytes || size > m_maxBytes) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        evict(it->second);
+    }
+
+    // make room, least recently used first
+    while (!m_lru.empty() && m_stats.bytes + size > m_maxBytes) {
+        evict(std::prev(m_lru.end()));
+        m_stats.evictions++;
+    }
+
+    m_lru.emplace_front(key, std::move(entry));
+    m_index[key] = m_lru.begin();
+    m_stats.bytes += size;
+    m_stats.entries = m_index.size();
+}
+
+void ResponseCache::countBypass() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.bypasses++;
+}
+
+void ResponseCache::evict(LruList::iterator it) {
+    m_stats.bytes -= entrySize(it->first, *it->second);
+    m_index.erase(it->first);
+    m_lru.erase(it);
+    m_stats.entries = m_index.size();
+}
+
+std::unique_ptr<HttpClient::Sink> ResponseCache::createFillSink(const std::string& key, std::chrono::seconds ttl) {
+    return std::make_unique<FillSink>(*this, key, ttl);
+}
+
+ResponseCache::Stats ResponseCache::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
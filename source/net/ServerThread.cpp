@@ -0,0 +1,81 @@
+#include <net/ServerThread.hpp>
+
+#include <cstdio>
+
+namespace {
+    // TLS handshakes in curl need quite some stack
+    constexpr size_t threadStackSize = 0x80000;
+    constexpr int threadPriority = 0x2C;
+}
+
+ServerThread::ServerThread(IEventLoop& loop, int core)
+    : m_loop(loop),
+      m_core(core),
+      m_thread{},
+      m_started(false) {}
+
+ServerThread::~ServerThread() {
+    stop();
+}
+
+std::vector<int> ServerThread::usableCores() {
+    std::vector<int> cores;
+    u64 coreMask = 0;
+    if (R_SUCCEEDED(svcGetInfo(&coreMask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0))) {
+        for (int core = 0; core < 4; core++) {
+            if (coreMask & (1ULL << core)) {
+                cores.push_back(core);
+            }
+        }
+    }
+    return cores;
+}
+
+int ServerThread::pickCore() {
+    int currentCore = static_cast<int>(svcGetCurrentProcessorNumber());
+    std::vector<int> cores = usableCores();
+    for (auto it = cores.rbegin(); it != cores.rend(); ++it) {
+        if (*it != currentCore) {
+            return *it;
+        }
+    }
+    return -2; // default core of the process
+}
+
+bool ServerThread::start() {
+    if (m_started) return true;
+
+    int core = (AnyCore == m_core) ? pickCore() : m_core;
+    Result r = threadCreate(&m_thread, ServerThread::threadFunc, this, nullptr, threadStackSize, threadPriority, core);
+    if (R_FAILED(r)) {
+        printf("ERROR creating server thread: %d\n", R_DESCRIPTION(r));
+        return false;
+    }
+    r = threadStart(&m_thread);
+    if (R_FAILED(r)) {
+        printf("ERROR starting server thread: %d\n", R_DESCRIPTION(r));
+        threadClose(&m_thread);
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+void ServerThread::stop() {
+    if (!m_started) return;
+
+    m_loop.stop();
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+    m_started = false;
+}
+
+void ServerThread::threadFunc(void* arg) {
+    ServerThread* self = static_cast<ServerThread*>(arg);
+    while (self->m_loop.isRunning()) {
+        // Blocks until a socket, a curl timer or stop() needs attention
+        if (!self->m_loop.serverLoop(-1)) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include <net/SharedCurlCache.hpp>
+
+#include <fstream>
+#include <sstream>
+
+SharedCurlCache::SharedCurlCache() {
+    m_shared = curl_share_init();
+    curl_share_setopt(m_shared, CURLSHOPT_LOCKFUNC, SharedCurlCache::lockCallback);
+    curl_share_setopt(m_shared, CURLSHOPT_UNLOCKFUNC, SharedCurlCache::unlockCallback);
+    curl_share_setopt(m_shared, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(m_shared, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(m_shared, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);      // Share DNS cache
+
+    loadCaBundle();
+}
+
+void SharedCurlCache::loadCaBundle() {
+#if LIBCURL_VERSION_NUM >= 0x075400 // CURLINFO_CAINFO needs 7.84.0
+    // Ask curl which bundle it would read on every new connection
+    CURL* curl = curl_easy_init();
+    if (!curl) return;
+    char* caPath = nullptr;
+    curl_easy_getinfo(curl, CURLINFO_CAINFO, &caPath);
+    std::string path = caPath ? caPath : "";
+    curl_easy_cleanup(curl);
+    if (path.empty()) return;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return;
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    m_caBundle = contents.str();
+#endif
+}
+
+SharedCurlCache::~SharedCurlCache() {
+    curl_share_cleanup(m_shared);
+}
+
+void SharedCurlCache::lockCallback(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    SharedCurlCache* self = static_cast<SharedCurlCache*>(userptr);
+    // curl only asks for shared access on a few data types, an exclusive lock is fine for all of them
+    self->m_locks[data].lock();
+}
+
+void SharedCurlCache::unlockCallback(CURL* handle, curl_lock_data data, void* userptr) {
+    SharedCurlCache* self = static_cast<SharedCurlCache*>(userptr);
+    self->m_locks[data].unlock();
+}
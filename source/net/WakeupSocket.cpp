@@ -0,0 +1,43 @@
+#include <net/WakeupSocket.hpp>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/fcntl.h>
+#include <sys/unistd.h>
+
+WakeupSocket::WakeupSocket()
+    : m_fd(-1),
+      m_addr{} {}
+
+WakeupSocket::~WakeupSocket() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool WakeupSocket::open() {
+    m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_fd < 0) return false;
+
+    int flags = fcntl(m_fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) == -1) return false;
+
+    m_addr.sin_family = AF_INET;
+    m_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    m_addr.sin_port = 0; // let the system pick a port
+    if (bind(m_fd, (struct sockaddr*)&m_addr, sizeof(m_addr)) < 0) return false;
+
+    socklen_t addrLen = sizeof(m_addr);
+    return getsockname(m_fd, (struct sockaddr*)&m_addr, &addrLen) == 0;
+}
+
+void WakeupSocket::wake() {
+    if (m_fd < 0) return;
+    const char wake = 1;
+    sendto(m_fd, &wake, sizeof(wake), 0, (struct sockaddr*)&m_addr, sizeof(m_addr));
+}
+
+void WakeupSocket::drain() {
+    char buf[16];
+    while (recv(m_fd, buf, sizeof(buf), 0) > 0) {}
+}